@@ -24,10 +24,6 @@
 #include "ns3/sdn-helper.h"
 #include "ns3/config-store.h"
 
-extern std::map<ns3::Ptr<ns3::Node>,int> NODETOIND;
-extern std::map<int,ns3::Ptr<ns3::Node>> INDTONODE;
-extern std::map<ns3::Ipv4Address,int> ADDTOIND;
-
 
 using namespace ns3;
 
@@ -70,11 +66,8 @@ main (int argc, char *argv[])
   NodeContainer c;
   c.Create(9);
 
-  for(int i = 0; i < 9; ++i)
-  {
-	  NODETOIND[c.Get(i)] = i;
-	  INDTONODE[i] = c.Get(i);
-  }
+  SDNHelper sdnh;
+  sdnh.Register(c);
 
   MobilityHelper mobility;
   mobility.SetPositionAllocator("ns3::ListPositionAllocator");
@@ -169,8 +162,6 @@ main (int argc, char *argv[])
 
 
 
-  SDNHelper sdnh;
-
   InternetStackHelper it;
   it.SetRoutingHelper(sdnh);
   it.Install(c);
@@ -195,14 +186,7 @@ main (int argc, char *argv[])
 
   ip.Assign(ndc);
 
-  for(int i = 0; i < 9; ++i)
-  {
-	  uint32_t interface = c.Get(i)->GetObject<Ipv4>()->GetNInterfaces();
-	  for(uint32_t it = 0; it < interface; ++it)
-	  {
-		  ADDTOIND[c.Get(i)->GetObject<Ipv4>()->GetAddress(it, 0).GetLocal()] = i;
-	  }
-  }
+  sdnh.RegisterAddresses(c);
 
 
 
@@ -265,6 +249,8 @@ main (int argc, char *argv[])
 
   Simulator::Stop(Seconds(15));
   Simulator::Run ();
+  sdnh.PrintFlowSetupStats(c, std::cout);
+  sdnh.PrintReconvergence(std::cout);
   Simulator::Destroy ();
 
   std::cout<<"TOTAL DROP NUMBER: " << num <<std::endl;
@@ -10,6 +10,8 @@ SDNHelper::SDNHelper():
 		Ipv4RoutingHelper()
 		{
 	m_agentFactory.SetTypeId("ns3::sdn::RoutingProtocol");
+	//the helper comes first in a script, after the defaults are configured
+	sdn::RoutingProtocol::NETCENTER.LoadDefaults();
 		}
 
 SDNHelper*
@@ -32,6 +34,85 @@ SDNHelper::Set(std::string name, const AttributeValue &value)
 	m_agentFactory.Set(name,value);
 }
 
+void
+SDNHelper::Register(NodeContainer c)
+{
+	for(uint32_t i = 0; i < c.GetN(); ++i)
+	{
+		sdn::RoutingProtocol::REGISTRY.AddNode(c.Get(i),i);
+	}
+}
+
+void
+SDNHelper::RegisterAddresses(NodeContainer c)
+{
+	for(uint32_t i = 0; i < c.GetN(); ++i)
+	{
+		Ptr<Ipv4> ipv4 = c.Get(i)->GetObject<Ipv4>();
+		if(!ipv4) continue;
+		for(uint32_t j = 0; j < ipv4->GetNInterfaces(); ++j)
+		{
+			for(uint32_t k = 0; k < ipv4->GetNAddresses(j); ++k)
+			{
+				sdn::RoutingProtocol::REGISTRY.AddAddress(ipv4->GetAddress(j,k).GetLocal(),i);
+			}
+		}
+	}
+}
+
+void
+SDNHelper::PrintFlowSetupStats(NodeContainer c, std::ostream& os) const
+{
+	sdn::FlowSetupStats total;
+	for(uint32_t i = 0; i < c.GetN(); ++i)
+	{
+		Ptr<sdn::RoutingProtocol> rp = c.Get(i)->GetObject<sdn::RoutingProtocol>();
+		if(!rp) continue;
+		os << "node " << c.Get(i)->GetId() << ": ";
+		rp->GetStats().Print(os);
+		os << std::endl;
+		total.Merge(rp->GetStats());
+	}
+	os << "total: ";
+	total.Print(os);
+	os << std::endl;
+}
+
+void
+SDNHelper::PrintReconvergence(std::ostream& os) const
+{
+	const sdn::ControlCenter& center = sdn::RoutingProtocol::NETCENTER;
+	os << "link failures " << center.GetLinkFailures()
+	   << " flows rerouted " << center.GetFlowsRerouted()
+	   << " reconvergence ";
+	center.GetReconvergence().Print(os);
+	os << std::endl;
+}
+
+void
+SDNHelper::PrintSprayStats(NodeContainer c, Time duration, std::ostream& os) const
+{
+	static const char* names[] = {"flow-hash", "round-robin", "flowlet"};
+	for(uint32_t m = 0; m < sdn::PathSprayer::MODE_COUNT; ++m)
+	{
+		sdn::SprayStats total;
+		for(uint32_t i = 0; i < c.GetN(); ++i)
+		{
+			Ptr<sdn::RoutingProtocol> rp = c.Get(i)->GetObject<sdn::RoutingProtocol>();
+			if(rp) total.Merge(rp->GetSprayStats((sdn::PathSprayer::Mode)m));
+		}
+		if(total.packets == 0 && total.delivered == 0) continue;
+		os << names[m] << ": ";
+		total.Print(os);
+		if(duration.IsStrictlyPositive())
+		{
+			//sent bytes count once per hop, delivered bytes once per packet
+			os << " throughput " << total.deliveredBytes * 8 / duration.GetSeconds() << "bit/s";
+		}
+		os << std::endl;
+	}
+}
+
 /* ... */
 
 
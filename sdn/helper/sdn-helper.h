@@ -21,6 +21,19 @@ public:
 
 	void Set(std::string name, const AttributeValue &value);
 
+	//index the nodes by their position in 'c', before the stack is installed
+	void Register(NodeContainer c);
+	//index every interface address of the nodes in 'c', after addressing
+	void RegisterAddresses(NodeContainer c);
+
+	//end-of-run flow setup summary, one line per node of 'c' and a total
+	void PrintFlowSetupStats(NodeContainer c, std::ostream& os) const;
+	//link failures seen by the controller, flows it rerouted and the time
+	//from a failure to the last new entry
+	void PrintReconvergence(std::ostream& os) const;
+	//totals per spraying mode, with the throughput over 'duration'
+	void PrintSprayStats(NodeContainer c, Time duration, std::ostream& os) const;
+
 private:
 	ObjectFactory m_agentFactory;
 };
@@ -0,0 +1,273 @@
+#include "sdn-controller-placement.h"
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+namespace ns3 {
+
+namespace sdn {
+
+ControllerPlacement::ControllerPlacement()
+	: m_objective(AVERAGE),
+	  m_capacity(0),
+	  m_maxSwaps(100),
+	  m_samples(0)
+{
+
+}
+
+void
+ControllerPlacement::SetObjective(Objective objective)
+{
+	m_objective = objective;
+}
+
+void
+ControllerPlacement::SetCapacity(uint32_t capacity)
+{
+	m_capacity = capacity;
+}
+
+void
+ControllerPlacement::SetMaxSwaps(uint32_t swaps)
+{
+	m_maxSwaps = swaps;
+}
+
+void
+ControllerPlacement::AddSample(const std::vector<std::vector<double>>& dist)
+{
+	if(m_samples == 0)
+	{
+		m_sum = dist;
+		m_max = dist;
+	}
+	else
+	{
+		for(uint32_t s = 0; s < dist.size() && s < m_sum.size(); ++s)
+		{
+			for(uint32_t c = 0; c < dist[s].size() && c < m_sum[s].size(); ++c)
+			{
+				m_sum[s][c] += dist[s][c];
+				m_max[s][c] = std::max(m_max[s][c],dist[s][c]);
+			}
+		}
+	}
+	++m_samples;
+}
+
+void
+ControllerPlacement::AddSample(const ControlCenter& center)
+{
+	AddSample(center.GetControlDistances());
+}
+
+void
+ControllerPlacement::AddSample(const SnapshotView& view)
+{
+	uint32_t n = view.GetHeader().numNodes;
+	//edges reversed, so a search from 'c' yields the delay from every switch to 'c'
+	std::vector<std::vector<std::pair<int,double>>> rev(n);
+	const SnapshotEdge* edges = view.GetEdges();
+	for(uint64_t i = 0; i < view.GetHeader().edgeCount; ++i)
+	{
+		const SnapshotEdge& e = edges[i];
+		if(view.GetAdjacency(e.from,e.to) != 1) continue;
+		rev[e.to].push_back({e.from,e.delay * 1e-9});
+	}
+
+	std::vector<std::vector<double>> dist(n,std::vector<double>(n,std::numeric_limits<double>::infinity()));
+	typedef std::pair<double,int> Item;
+	for(uint32_t c = 0; c < n; ++c)
+	{
+		std::vector<double> d(n,std::numeric_limits<double>::infinity());
+		std::priority_queue<Item,std::vector<Item>,std::greater<Item>> heap;
+		d[c] = 0;
+		heap.push({0,c});
+		while(!heap.empty())
+		{
+			Item top = heap.top();
+			heap.pop();
+			if(top.first > d[top.second]) continue;
+			for(auto it = rev[top.second].begin(); it != rev[top.second].end(); ++it)
+			{
+				double nd = top.first + it->second;
+				if(nd < d[it->first])
+				{
+					d[it->first] = nd;
+					heap.push({nd,it->first});
+				}
+			}
+		}
+		for(uint32_t s = 0; s < n; ++s)
+		{
+			dist[s][c] = d[s];
+		}
+	}
+	AddSample(dist);
+}
+
+void
+ControllerPlacement::Clear()
+{
+	m_sum.clear();
+	m_max.clear();
+	m_samples = 0;
+}
+
+double
+ControllerPlacement::Distance(int s, int c)const
+{
+	return m_objective == WORST ? m_max[s][c] : m_sum[s][c] / m_samples;
+}
+
+double
+ControllerPlacement::Assign(const std::vector<int>& controllers, std::vector<int>& assignment)const
+{
+	int n = m_sum.size();
+	assignment.assign(n,-1);
+	std::vector<uint32_t> used(n,0);
+	for(auto c = controllers.begin(); c != controllers.end(); ++c)
+	{
+		assignment[*c] = *c;
+		used[*c] = 1;
+	}
+
+	//switches with the most to lose from missing their nearest controller go first
+	std::vector<std::pair<double,int>> order;
+	for(int s = 0; s < n; ++s)
+	{
+		if(assignment[s] != -1) continue;
+		double best = std::numeric_limits<double>::infinity();
+		double second = std::numeric_limits<double>::infinity();
+		for(auto c = controllers.begin(); c != controllers.end(); ++c)
+		{
+			double d = Distance(s,*c);
+			if(d < best)
+			{
+				second = best;
+				best = d;
+			}
+			else if(d < second)
+			{
+				second = d;
+			}
+		}
+		order.push_back({-(second - best),s});
+	}
+	std::sort(order.begin(),order.end());
+
+	double total = 0;
+	double worst = 0;
+	for(auto it = order.begin(); it != order.end(); ++it)
+	{
+		int s = it->second;
+		double best = std::numeric_limits<double>::infinity();
+		for(auto c = controllers.begin(); c != controllers.end(); ++c)
+		{
+			if(m_capacity > 0 && used[*c] >= m_capacity) continue;
+			double d = Distance(s,*c);
+			if(d < best)
+			{
+				best = d;
+				assignment[s] = *c;
+			}
+		}
+		if(assignment[s] == -1) return std::numeric_limits<double>::infinity();
+		++used[assignment[s]];
+		total += best;
+		worst = std::max(worst,best);
+	}
+	if(m_objective == WORST) return worst;
+	return n > 0 ? total / n : 0;
+}
+
+ControllerPlacement::Result
+ControllerPlacement::Solve(uint32_t k)const
+{
+	Result result;
+	result.cost = std::numeric_limits<double>::infinity();
+	int n = m_sum.size();
+	if(m_samples == 0 || n == 0 || k == 0) return result;
+	k = std::min<uint32_t>(k,n);
+
+	//greedy: open the controller that lowers the cost the most
+	std::vector<int> chosen;
+	std::vector<bool> open(n,false);
+	std::vector<int> assignment;
+	double cost = std::numeric_limits<double>::infinity();
+	while(chosen.size() < k)
+	{
+		int best_c = -1;
+		double best_cost = std::numeric_limits<double>::infinity();
+		for(int c = 0; c < n; ++c)
+		{
+			if(open[c]) continue;
+			chosen.push_back(c);
+			double t = Assign(chosen,assignment);
+			chosen.pop_back();
+			if(best_c == -1 || t < best_cost)
+			{
+				best_c = c;
+				best_cost = t;
+			}
+		}
+		chosen.push_back(best_c);
+		open[best_c] = true;
+		cost = best_cost;
+	}
+
+	//swap: replace an open controller by a closed node while it helps
+	bool improved = true;
+	for(uint32_t swaps = 0; improved && swaps < m_maxSwaps; )
+	{
+		improved = false;
+		for(uint32_t i = 0; i < chosen.size() && !improved; ++i)
+		{
+			for(int c = 0; c < n && !improved; ++c)
+			{
+				if(open[c]) continue;
+				int old = chosen[i];
+				chosen[i] = c;
+				double t = Assign(chosen,assignment);
+				if(t < cost)
+				{
+					open[old] = false;
+					open[c] = true;
+					cost = t;
+					improved = true;
+					++swaps;
+				}
+				else
+				{
+					chosen[i] = old;
+				}
+			}
+		}
+	}
+
+	result.controllers = chosen;
+	result.cost = Assign(chosen,result.assignment);
+	return result;
+}
+
+void
+ControllerPlacement::Apply(const Result& result, ControlCenter& center)const
+{
+	center.ClearControllers();
+	for(auto c = result.controllers.begin(); c != result.controllers.end(); ++c)
+	{
+		center.SetController(*c);
+	}
+	for(uint32_t s = 0; s < result.assignment.size(); ++s)
+	{
+		if(result.assignment[s] != -1)
+		{
+			center.AddSwitchToController(s,result.assignment[s]);
+		}
+	}
+}
+
+}
+
+}
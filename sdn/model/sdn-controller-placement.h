@@ -0,0 +1,65 @@
+#ifndef SDN_CONTROLLER_PLACEMENT_H
+#define SDN_CONTROLLER_PLACEMENT_H
+
+#include "sdn-netview.h"
+#include "sdn-snapshot.h"
+#include <vector>
+
+namespace ns3 {
+
+namespace sdn {
+
+//Picks K controller nodes and assigns every switch to one of them so the
+//switch-to-controller delay is minimized, on average or in the worst case,
+//with at most 'capacity' switches per controller. Several topology samples
+//(snapshots over time) can be given; they are folded into one distance matrix
+//up front, so a solve only works on precomputed distances: greedy opening
+//of controllers followed by swap improvement.
+class ControllerPlacement
+{
+public:
+	enum Objective
+	{
+		AVERAGE,
+		WORST
+	};
+
+	struct Result
+	{
+		std::vector<int> controllers;
+		std::vector<int> assignment;		//controller of every node, -1 if it could not be placed
+		double cost;
+	};
+
+	ControllerPlacement();
+
+	void SetObjective(Objective);
+	void SetCapacity(uint32_t);		//switches per controller including itself, 0 means unbounded
+	void SetMaxSwaps(uint32_t);
+
+	//dist[s][c] is the delay in seconds from switch 's' to node 'c'
+	void AddSample(const std::vector<std::vector<double>>& dist);
+	void AddSample(const ControlCenter& center);
+	void AddSample(const SnapshotView& view);
+	void Clear();
+
+	Result Solve(uint32_t k)const;
+	void Apply(const Result&, ControlCenter& center)const;
+
+private:
+	double Distance(int,int)const;
+	double Assign(const std::vector<int>& controllers, std::vector<int>& assignment)const;
+
+	Objective m_objective;
+	uint32_t m_capacity;
+	uint32_t m_maxSwaps;
+	uint32_t m_samples;
+	std::vector<std::vector<double>> m_sum;		//samples summed, for the average
+	std::vector<std::vector<double>> m_max;		//worst sample per pair
+};
+
+}
+
+}
+
+#endif
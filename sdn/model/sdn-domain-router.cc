@@ -0,0 +1,337 @@
+#include "sdn-domain-router.h"
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+namespace ns3 {
+
+namespace sdn {
+
+DomainRouter::DomainRouter()
+	: m_built(false)
+{
+
+}
+
+void
+DomainRouter::Build(const std::vector<int>& domain, const std::vector<Link>& links)
+{
+	int n = domain.size();
+	m_domainOf.assign(n,-1);
+	m_localOf.assign(n,-1);
+	m_domains.clear();
+	m_borders.clear();
+	m_borderIndex.clear();
+	m_borderAdj.clear();
+
+	std::map<int,int> slots;
+	for(int i = 0; i < n; ++i)
+	{
+		if(domain[i] == -1) continue;
+		auto it = slots.find(domain[i]);
+		if(it == slots.end())
+		{
+			it = slots.insert({domain[i],(int)m_domains.size()}).first;
+			m_domains.push_back(Domain());
+		}
+		Domain& d = m_domains[it->second];
+		m_domainOf[i] = it->second;
+		m_localOf[i] = d.nodes.size();
+		d.nodes.push_back(i);
+	}
+	for(auto it = m_domains.begin(); it != m_domains.end(); ++it)
+	{
+		it->out.resize(it->nodes.size());
+		it->in.resize(it->nodes.size());
+	}
+
+	//intra-domain links go to the domain graph, the others make borders
+	std::vector<Link> inter;
+	for(auto it = links.begin(); it != links.end(); ++it)
+	{
+		if(it->from >= n || it->to >= n) continue;
+		int df = m_domainOf[it->from];
+		int dt = m_domainOf[it->to];
+		if(df == -1 || dt == -1) continue;
+		if(df == dt)
+		{
+			Domain& d = m_domains[df];
+			d.out[m_localOf[it->from]].push_back({m_localOf[it->to],it->cost});
+			d.in[m_localOf[it->to]].push_back({m_localOf[it->from],it->cost});
+			continue;
+		}
+		inter.push_back(*it);
+		int ends[2] = {it->from,it->to};
+		for(int e = 0; e < 2; ++e)
+		{
+			if(m_borderIndex.count(ends[e])) continue;
+			m_borderIndex[ends[e]] = m_borders.size();
+			m_borders.push_back(ends[e]);
+			m_domains[m_domainOf[ends[e]]].borders.push_back(m_localOf[ends[e]]);
+		}
+	}
+	m_borderAdj.resize(m_borders.size());
+
+	for(auto it = inter.begin(); it != inter.end(); ++it)
+	{
+		BorderEdge edge;
+		edge.to = m_borderIndex[it->to];
+		edge.cost = it->cost;
+		edge.segment.push_back(it->to);
+		edge.inter = true;
+		m_borderAdj[m_borderIndex[it->from]].push_back(edge);
+	}
+
+	//border to border segments inside every domain
+	m_stale.assign(m_domains.size(),false);
+	for(uint32_t d = 0; d < m_domains.size(); ++d)
+	{
+		BuildSegments(d);
+	}
+	m_built = true;
+}
+
+void
+DomainRouter::BuildSegments(int slot)
+{
+	//drop the old segments leaving the domain's borders, keep the inter-domain links
+	Domain& d = m_domains[slot];
+	for(auto b = d.borders.begin(); b != d.borders.end(); ++b)
+	{
+		std::vector<BorderEdge>& adj = m_borderAdj[m_borderIndex[d.nodes[*b]]];
+		adj.erase(std::remove_if(adj.begin(),adj.end(),[](const BorderEdge& e){return !e.inter;}),adj.end());
+	}
+	std::vector<double> dist;
+	std::vector<int> prev;
+	for(auto b = d.borders.begin(); b != d.borders.end(); ++b)
+	{
+		Search(d,*b,false,dist,prev);
+		for(auto o = d.borders.begin(); o != d.borders.end(); ++o)
+		{
+			if(o == b || dist[*o] == std::numeric_limits<double>::infinity()) continue;
+			BorderEdge edge;
+			edge.to = m_borderIndex[d.nodes[*o]];
+			edge.cost = dist[*o];
+			edge.inter = false;
+			for(int cur = *o; cur != *b; cur = prev[cur])
+			{
+				edge.segment.push_back(d.nodes[cur]);
+			}
+			std::reverse(edge.segment.begin(),edge.segment.end());
+			m_borderAdj[m_borderIndex[d.nodes[*b]]].push_back(edge);
+		}
+	}
+	m_stale[slot] = false;
+}
+
+static void
+SetArc(std::vector<std::pair<int,double>>& arcs, int to, double cost)
+{
+	for(auto it = arcs.begin(); it != arcs.end(); ++it)
+	{
+		if(it->first != to) continue;
+		if(cost == std::numeric_limits<double>::infinity()) arcs.erase(it);
+		else it->second = cost;
+		return;
+	}
+	if(cost != std::numeric_limits<double>::infinity()) arcs.push_back({to,cost});
+}
+
+bool
+DomainRouter::SetLinkCost(int from, int to, double cost)
+{
+	if(!m_built) return false;
+	if(from >= (int)m_domainOf.size() || to >= (int)m_domainOf.size()) return true;
+	int df = m_domainOf[from];
+	int dt = m_domainOf[to];
+	if(df == -1 || dt == -1) return true;
+	bool up = cost != std::numeric_limits<double>::infinity();
+	if(df == dt)
+	{
+		Domain& d = m_domains[df];
+		SetArc(d.out[m_localOf[from]],m_localOf[to],cost);
+		SetArc(d.in[m_localOf[to]],m_localOf[from],cost);
+		m_stale[df] = true;
+		return true;
+	}
+
+	//inter-domain link: only its own border edge moves, a new link
+	//between nodes that are not borders yet changes the border graph
+	auto bf = m_borderIndex.find(from);
+	auto bt = m_borderIndex.find(to);
+	if(bf == m_borderIndex.end() || bt == m_borderIndex.end()) return !up;
+	std::vector<BorderEdge>& adj = m_borderAdj[bf->second];
+	for(auto it = adj.begin(); it != adj.end(); ++it)
+	{
+		if(!it->inter || it->to != bt->second) continue;
+		if(up) it->cost = cost;
+		else adj.erase(it);
+		return true;
+	}
+	if(up)
+	{
+		BorderEdge edge;
+		edge.to = bt->second;
+		edge.cost = cost;
+		edge.segment.push_back(to);
+		edge.inter = true;
+		adj.push_back(edge);
+	}
+	return true;
+}
+
+void
+DomainRouter::Refresh()
+{
+	for(uint32_t d = 0; d < m_domains.size(); ++d)
+	{
+		if(m_stale[d]) BuildSegments(d);
+	}
+}
+
+bool
+DomainRouter::IsBuilt()const
+{
+	return m_built;
+}
+
+uint32_t
+DomainRouter::GetBorderCount()const
+{
+	return m_borders.size();
+}
+
+void
+DomainRouter::Search(const Domain& d, int root, bool reverse, std::vector<double>& dist, std::vector<int>& prev)const
+{
+	//reverse == true gives the cost to 'root' and prev[] as the next hop towards it
+	int n = d.nodes.size();
+	dist.assign(n,std::numeric_limits<double>::infinity());
+	prev.assign(n,-1);
+	typedef std::pair<double,int> Item;
+	std::priority_queue<Item,std::vector<Item>,std::greater<Item>> heap;
+	dist[root] = 0;
+	heap.push({0,root});
+	const std::vector<std::vector<std::pair<int,double>>>& adj = reverse ? d.in : d.out;
+	while(!heap.empty())
+	{
+		Item top = heap.top();
+		heap.pop();
+		int u = top.second;
+		if(top.first > dist[u]) continue;
+		for(auto it = adj[u].begin(); it != adj[u].end(); ++it)
+		{
+			double nd = dist[u] + it->second;
+			if(nd < dist[it->first])
+			{
+				dist[it->first] = nd;
+				prev[it->first] = u;
+				heap.push({nd,it->first});
+			}
+		}
+	}
+}
+
+std::vector<int>
+DomainRouter::Path(int src, int dst)const
+{
+	std::vector<int> path;
+	if(!m_built || src >= (int)m_domainOf.size() || dst >= (int)m_domainOf.size()) return path;
+	int ds = m_domainOf[src];
+	int dd = m_domainOf[dst];
+	if(ds == -1 || dd == -1) return path;
+
+	const Domain& sd = m_domains[ds];
+	std::vector<double> from_src;
+	std::vector<int> prev_src;
+	Search(sd,m_localOf[src],false,from_src,prev_src);
+
+	double direct = std::numeric_limits<double>::infinity();
+	if(ds == dd)
+	{
+		direct = from_src[m_localOf[dst]];
+	}
+
+	const Domain& td = m_domains[dd];
+	std::vector<double> to_dst;
+	std::vector<int> next_dst;
+	Search(td,m_localOf[dst],true,to_dst,next_dst);
+
+	//search over the border graph, seeded by the borders the source reaches
+	int nb = m_borders.size();
+	std::vector<double> dist(nb,std::numeric_limits<double>::infinity());
+	std::vector<std::pair<int,int>> via(nb,{-1,-1});		//(border, edge index) it was reached by
+	typedef std::pair<double,int> Item;
+	std::priority_queue<Item,std::vector<Item>,std::greater<Item>> heap;
+	for(auto b = sd.borders.begin(); b != sd.borders.end(); ++b)
+	{
+		int bi = m_borderIndex.find(sd.nodes[*b])->second;
+		dist[bi] = from_src[*b];
+		if(dist[bi] < std::numeric_limits<double>::infinity()) heap.push({dist[bi],bi});
+	}
+	double best = direct;
+	int exit = -1;
+	while(!heap.empty())
+	{
+		Item top = heap.top();
+		heap.pop();
+		int u = top.second;
+		if(top.first > dist[u]) continue;
+		if(top.first >= best) break;
+		int node = m_borders[u];
+		if(m_domainOf[node] == dd && dist[u] + to_dst[m_localOf[node]] < best)
+		{
+			best = dist[u] + to_dst[m_localOf[node]];
+			exit = u;
+		}
+		for(uint32_t e = 0; e < m_borderAdj[u].size(); ++e)
+		{
+			const BorderEdge& edge = m_borderAdj[u][e];
+			double nd = dist[u] + edge.cost;
+			if(nd < dist[edge.to])
+			{
+				dist[edge.to] = nd;
+				via[edge.to] = {u,(int)e};
+				heap.push({nd,edge.to});
+			}
+		}
+	}
+
+	if(exit == -1)
+	{
+		if(direct == std::numeric_limits<double>::infinity()) return path;
+		for(int cur = m_localOf[dst]; cur != -1; cur = prev_src[cur])
+		{
+			path.push_back(sd.nodes[cur]);
+		}
+		std::reverse(path.begin(),path.end());
+		return path;
+	}
+
+	//border part, collected backwards from the exit border
+	std::vector<const std::vector<int>*> segments;
+	int entry = exit;
+	while(via[entry].first != -1)
+	{
+		segments.push_back(&m_borderAdj[via[entry].first][via[entry].second].segment);
+		entry = via[entry].first;
+	}
+	for(int cur = m_localOf[m_borders[entry]]; cur != -1; cur = prev_src[cur])
+	{
+		path.push_back(sd.nodes[cur]);
+	}
+	std::reverse(path.begin(),path.end());
+	for(auto it = segments.rbegin(); it != segments.rend(); ++it)
+	{
+		path.insert(path.end(),(*it)->begin(),(*it)->end());
+	}
+	for(int cur = next_dst[m_localOf[m_borders[exit]]]; cur != -1; cur = next_dst[cur])
+	{
+		path.push_back(td.nodes[cur]);
+	}
+	return path;
+}
+
+}
+
+}
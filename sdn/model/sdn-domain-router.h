@@ -0,0 +1,78 @@
+#ifndef SDN_DOMAIN_ROUTER_H
+#define SDN_DOMAIN_ROUTER_H
+
+#include <stdint.h>
+#include <vector>
+#include <map>
+
+namespace ns3 {
+
+namespace sdn {
+
+//Path computation split by controller domain. Every domain keeps a graph of
+//its own nodes only; the nodes with a link into another domain form the
+//border graph, whose edges are either such inter-domain links or the
+//shortest intra-domain segments between two borders of one domain.
+//A path inside a domain is searched on that domain alone; an inter-domain
+//path joins the source segment, a search over the border graph and the
+//destination segment.
+class DomainRouter
+{
+public:
+	struct Link
+	{
+		int from;
+		int to;
+		double cost;
+	};
+
+	DomainRouter();
+
+	//domain[i] is the domain of node i, -1 keeps the node out of every domain
+	void Build(const std::vector<int>& domain, const std::vector<Link>& links);
+	bool IsBuilt()const;
+	//change the cost of one link, infinity takes it out; the segments of its
+	//domain are recomputed by Refresh. False if the border set would change,
+	//the caller has to Build again
+	bool SetLinkCost(int from, int to, double cost);
+	void Refresh();
+	std::vector<int> Path(int src, int dst)const;
+
+	uint32_t GetBorderCount()const;
+
+private:
+	struct Domain
+	{
+		std::vector<int> nodes;		//local index -> node
+		std::vector<std::vector<std::pair<int,double>>> out;		//local adjacency
+		std::vector<std::vector<std::pair<int,double>>> in;
+		std::vector<int> borders;		//local indices
+	};
+
+	struct BorderEdge
+	{
+		int to;		//border index
+		double cost;
+		std::vector<int> segment;		//nodes after the start up to 'to'
+		bool inter;		//an inter-domain link, not a segment
+	};
+
+	void BuildSegments(int domain);
+	void Search(const Domain&, int root, bool reverse, std::vector<double>& dist, std::vector<int>& prev)const;
+
+	bool m_built;
+	std::vector<int> m_domainOf;		//node -> domain slot, -1 if none
+	std::vector<int> m_localOf;		//node -> local index in its domain
+	std::vector<Domain> m_domains;
+	std::vector<bool> m_stale;		//domain slot -> segments to recompute
+
+	std::vector<int> m_borders;		//border index -> node
+	std::map<int,int> m_borderIndex;		//node -> border index
+	std::vector<std::vector<BorderEdge>> m_borderAdj;
+};
+
+}
+
+}
+
+#endif
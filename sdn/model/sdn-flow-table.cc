@@ -1,4 +1,5 @@
 #include "sdn-flow-table.h"
+#include <algorithm>
 
 namespace ns3 {
 
@@ -73,6 +74,50 @@ namespace sdn {
 //	return m_dev;
 //}
 
+NextHopGroup::NextHopGroup()
+{
+
+}
+
+void
+NextHopGroup::Add(Ptr<Ipv4Route> route, double weight)
+{
+	double total = m_cumulative.empty() ? 0 : m_cumulative.back();
+	m_routes.push_back(route);
+	m_cumulative.push_back(total + std::max(weight, 0.0));
+}
+
+Ptr<Ipv4Route>
+NextHopGroup::Select(uint32_t hash)const
+{
+	if(m_routes.empty()) return Ptr<Ipv4Route>();
+	if(m_routes.size() == 1 || m_cumulative.back() <= 0) return m_routes.front();
+
+	//map the hash onto [0,total) and take the member owning that slice
+	double point = (hash / 4294967296.0) * m_cumulative.back();
+	auto it = std::upper_bound(m_cumulative.begin(), m_cumulative.end(), point);
+	if(it == m_cumulative.end()) return m_routes.back();
+	return m_routes[it - m_cumulative.begin()];
+}
+
+Ptr<Ipv4Route>
+NextHopGroup::Get(uint32_t i)const
+{
+	return m_routes[i];
+}
+
+double
+NextHopGroup::GetWeight(uint32_t i)const
+{
+	return i == 0 ? m_cumulative[0] : m_cumulative[i] - m_cumulative[i-1];
+}
+
+uint32_t
+NextHopGroup::GetN()const
+{
+	return m_routes.size();
+}
+
 FlowTable::FlowTable()
 {
 
@@ -81,13 +126,15 @@ FlowTable::FlowTable()
 bool
 FlowTable::IsExist(Ipv4Address src, Ipv4Address dst)const
 {
-	return m_table.count({src,dst});
+	return m_table.count({src,dst}) || m_dstTable.count(dst);
 }
 
 void
 FlowTable::Add(Ipv4Address src, Ipv4Address dst, Ptr<Ipv4Route> fte)
 {
-	m_table[{src,dst}] = fte;
+	NextHopGroup group;
+	group.Add(fte,1);
+	Add(src,dst,group);
 }
 
 void
@@ -98,22 +145,388 @@ FlowTable::Add(Ipv4Address src, Ipv4Address dst, Ipv4Route fte)
 	rte->SetDestination(fte.GetDestination());
 	rte->SetGateway(fte.GetGateway());
 	rte->SetOutputDevice(fte.GetOutputDevice());
-	m_table[{src,dst}] = rte;
+	Add(src,dst,rte);
+}
+
+void
+FlowTable::Add(Ipv4Address src, Ipv4Address dst, const NextHopGroup& group)
+{
+	Index({src,dst},false);
+	m_table[{src,dst}] = group;
+	Index({src,dst},true);
 }
 
 Ptr<Ipv4Route>
 FlowTable::Get(Ipv4Address src, Ipv4Address dst)
 {
-	return m_table[{src,dst}];
+	return Get(src,dst,0);
+}
+
+Ptr<Ipv4Route>
+FlowTable::Get(Ipv4Address src, Ipv4Address dst, uint32_t hash)
+{
+	auto it = m_table.find({src,dst});
+	if(it != m_table.end())
+	{
+		Ptr<Ipv4Route> route = it->second.Select(hash);
+		if(IsUsable(route))
+		{
+			return route;
+		}
+		//local failover: the backup first, then any other member still up
+		auto bit = m_backup.find({src,dst});
+		if(bit != m_backup.end() && IsUsable(bit->second))
+		{
+			return bit->second;
+		}
+		for(uint32_t i = 0; i < it->second.GetN(); ++i)
+		{
+			if(IsUsable(it->second.Get(i)))
+			{
+				return it->second.Get(i);
+			}
+		}
+		return route;
+	}
+	auto dit = m_dstTable.find(dst);
+	if(dit != m_dstTable.end())
+	{
+		return dit->second;
+	}
+	return Ptr<Ipv4Route>();
 }
 
 void
 FlowTable::Delete(Ipv4Address src, Ipv4Address dst)
 {
-	if(IsExist(src,dst))
+	Index({src,dst},false);
+	m_table.erase({src,dst});
+	m_backup.erase({src,dst});
+}
+
+void
+FlowTable::SetBackup(Ipv4Address src, Ipv4Address dst, Ptr<Ipv4Route> route)
+{
+	Index({src,dst},false);
+	m_backup[{src,dst}] = route;
+	Index({src,dst},true);
+}
+
+void
+FlowTable::SetDeviceUp(Ptr<NetDevice> dev, bool up)
+{
+	if(up)
+	{
+		m_downDevices.erase(dev);
+	}
+	else
+	{
+		m_downDevices.insert(dev);
+	}
+}
+
+bool
+FlowTable::IsDeviceUp(Ptr<NetDevice> dev)const
+{
+	return !m_downDevices.count(dev);
+}
+
+bool
+FlowTable::IsUsable(Ptr<Ipv4Route> route)const
+{
+	if(!route) return false;
+	Ptr<NetDevice> dev = route->GetOutputDevice();
+	return dev && !m_downDevices.count(dev) && dev->IsLinkUp();
+}
+
+void
+FlowTable::AddDestination(Ipv4Address dst, Ptr<Ipv4Route> route)
+{
+	IndexDestination(dst,false);
+	m_dstTable[dst] = route;
+	IndexDestination(dst,true);
+}
+
+void
+FlowTable::DeleteDestination(Ipv4Address dst)
+{
+	IndexDestination(dst,false);
+	m_dstTable.erase(dst);
+}
+
+void
+FlowTable::Index(const FlowKey& key, bool add)
+{
+	std::vector<Ptr<NetDevice>> devs;
+	auto it = m_table.find(key);
+	if(it != m_table.end())
+	{
+		for(uint32_t i = 0; i < it->second.GetN(); ++i)
+		{
+			if(it->second.Get(i)) devs.push_back(it->second.Get(i)->GetOutputDevice());
+		}
+	}
+	auto bit = m_backup.find(key);
+	if(bit != m_backup.end() && bit->second)
+	{
+		devs.push_back(bit->second->GetOutputDevice());
+	}
+	for(auto dev = devs.begin(); dev != devs.end(); ++dev)
+	{
+		if(!*dev) continue;
+		if(add)
+		{
+			m_deviceFlows[*dev].insert(key);
+			continue;
+		}
+		auto dit = m_deviceFlows.find(*dev);
+		if(dit == m_deviceFlows.end()) continue;
+		dit->second.erase(key);
+		if(dit->second.empty()) m_deviceFlows.erase(dit);
+	}
+}
+
+void
+FlowTable::IndexDestination(Ipv4Address dst, bool add)
+{
+	auto it = m_dstTable.find(dst);
+	if(it == m_dstTable.end() || !it->second || !it->second->GetOutputDevice()) return;
+	Ptr<NetDevice> dev = it->second->GetOutputDevice();
+	if(add)
+	{
+		m_deviceDsts[dev].insert(dst);
+		return;
+	}
+	auto dit = m_deviceDsts.find(dev);
+	if(dit == m_deviceDsts.end()) return;
+	dit->second.erase(dst);
+	if(dit->second.empty()) m_deviceDsts.erase(dit);
+}
+
+uint32_t
+FlowTable::PurgeDevice(Ptr<NetDevice> dev)
+{
+	uint32_t purged = 0;
+	auto fit = m_deviceFlows.find(dev);
+	if(fit != m_deviceFlows.end())
+	{
+		std::set<FlowKey> keys;
+		keys.swap(fit->second);
+		m_deviceFlows.erase(fit);
+		for(auto key = keys.begin(); key != keys.end(); ++key)
+		{
+			++purged;
+			Index(*key,false);
+			auto bit = m_backup.find(*key);
+			if(bit != m_backup.end() && (!bit->second || bit->second->GetOutputDevice() == dev))
+			{
+				m_backup.erase(bit);
+				bit = m_backup.end();
+			}
+			auto it = m_table.find(*key);
+			if(it == m_table.end())
+			{
+				Index(*key,true);
+				continue;
+			}
+			NextHopGroup kept;
+			for(uint32_t i = 0; i < it->second.GetN(); ++i)
+			{
+				Ptr<Ipv4Route> route = it->second.Get(i);
+				if(route && route->GetOutputDevice() != dev)
+				{
+					kept.Add(route,it->second.GetWeight(i));
+				}
+			}
+			if(kept.GetN() == 0 && bit != m_backup.end())
+			{
+				kept.Add(bit->second,1);
+				m_backup.erase(bit);
+			}
+			if(kept.GetN() == 0)
+			{
+				m_table.erase(it);
+				continue;
+			}
+			it->second = kept;
+			Index(*key,true);
+		}
+	}
+	auto dit = m_deviceDsts.find(dev);
+	if(dit != m_deviceDsts.end())
+	{
+		for(auto dst = dit->second.begin(); dst != dit->second.end(); ++dst)
+		{
+			m_dstTable.erase(*dst);
+			++purged;
+		}
+		m_deviceDsts.erase(dit);
+	}
+	return purged;
+}
+
+static const uint32_t PRUNE_MIN = 1024;
+
+//murmur3 finalizer, spreads a flowlet number over the whole hash range
+static uint32_t
+Mix(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+PathSprayer::PathSprayer()
+	: m_mode(FLOW_HASH),
+	  m_gap(MicroSeconds(500)),
+	  m_pruneAt(PRUNE_MIN),
+	  m_deliveredPruneAt(PRUNE_MIN)
+{
+
+}
+
+void
+PathSprayer::SetMode(Mode mode)
+{
+	m_mode = mode;
+}
+
+PathSprayer::Mode
+PathSprayer::GetMode()const
+{
+	return m_mode;
+}
+
+void
+PathSprayer::SetFlowletGap(Time gap)
+{
+	m_gap = gap;
+}
+
+Time
+PathSprayer::GetFlowletGap()const
+{
+	return m_gap;
+}
+
+Ptr<Ipv4Route>
+PathSprayer::Select(FlowTable& table, Ipv4Address src, Ipv4Address dst, uint32_t flow, uint32_t bytes, Time now)
+{
+	SprayStats& stats = m_stats[m_mode];
+	++stats.packets;
+	stats.bytes += bytes;
+	if(m_mode == FLOW_HASH)
+	{
+		//stateless, a flow only changes member when its entry does
+		return table.Get(src,dst,flow);
+	}
+
+	if(m_flows.size() >= m_pruneAt)
+	{
+		Prune(now);
+	}
+	FlowState& state = m_flows[flow];
+	uint32_t hash;
+	if(m_mode == ROUND_ROBIN)
+	{
+		//golden ratio steps cover [0,2^32) evenly, so each member gets a
+		//share of the packets matching its weight
+		hash = flow + state.sent * 2654435769u;
+	}
+	else
+	{
+		if(!state.route || now - state.last > m_gap)
+		{
+			++state.flowlet;
+			++stats.flowlets;
+		}
+		hash = Mix(flow + state.flowlet * 2654435769u);
+	}
+	Ptr<Ipv4Route> route = table.Get(src,dst,hash);
+	if(state.route && route != state.route)
 	{
-		m_table.erase({src,dst});
+		++stats.switches;
 	}
+	++state.sent;
+	state.last = now;
+	state.route = route;
+	return route;
+}
+
+void
+PathSprayer::Prune(Time now)
+{
+	//a flow idle for longer than the gap starts a new flowlet anyway
+	Time horizon = std::max(m_gap, Seconds(1));
+	for(auto it = m_flows.begin(); it != m_flows.end();)
+	{
+		if(now - it->second.last > horizon)
+		{
+			it = m_flows.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	m_pruneAt = std::max<size_t>(PRUNE_MIN, 2 * m_flows.size());
+}
+
+void
+PathSprayer::Deliver(uint32_t flow, uint64_t uid, uint32_t bytes, Time now)
+{
+	SprayStats& stats = m_stats[m_mode];
+	++stats.delivered;
+	stats.deliveredBytes += bytes;
+	if(m_delivered.size() >= m_deliveredPruneAt)
+	{
+		PruneDelivered(now);
+	}
+	auto it = m_delivered.find(flow);
+	if(it == m_delivered.end())
+	{
+		DeliveryState& state = m_delivered[flow];
+		state.uid = uid;
+		state.last = now;
+		return;
+	}
+	it->second.last = now;
+	if(uid < it->second.uid)
+	{
+		++stats.reordered;
+	}
+	else
+	{
+		it->second.uid = uid;
+	}
+}
+
+void
+PathSprayer::PruneDelivered(Time now)
+{
+	//a flow quiet for that long has no packet left in flight to arrive late
+	Time horizon = std::max(m_gap, Seconds(1));
+	for(auto it = m_delivered.begin(); it != m_delivered.end();)
+	{
+		if(now - it->second.last > horizon)
+		{
+			it = m_delivered.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	m_deliveredPruneAt = std::max<size_t>(PRUNE_MIN, 2 * m_delivered.size());
+}
+
+const SprayStats&
+PathSprayer::GetStats(Mode mode)const
+{
+	return m_stats[mode];
 }
 
 }
@@ -4,6 +4,12 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/net-device.h"
 #include "ns3/ipv4-route.h"
+#include "ns3/nstime.h"
+#include "sdn-stats.h"
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
 
 namespace ns3 {
 
@@ -43,6 +49,33 @@ namespace sdn {
 //
 //};
 
+//one hop of a flow pushed by the controller: send (src,dst) towards 'next';
+//an uninitialized 'src' is a destination-only entry, 'next' == -1 removes it
+struct FlowInstall
+{
+	Ipv4Address src;
+	Ipv4Address dst;
+	int next;
+	int backup = -1;		//loop-free alternate, flow entries only
+};
+
+//a set of next hops for one flow, each member carries a weight;
+//a member is picked from the flow hash in proportion to its weight
+class NextHopGroup
+{
+public:
+	NextHopGroup();
+	void Add(Ptr<Ipv4Route>,double);
+	Ptr<Ipv4Route> Select(uint32_t)const;
+	Ptr<Ipv4Route> Get(uint32_t)const;
+	double GetWeight(uint32_t)const;
+	uint32_t GetN()const;
+
+private:
+	std::vector<Ptr<Ipv4Route>> m_routes;
+	std::vector<double> m_cumulative;		//running sum of the member weights
+};
+
 class FlowTable
 {
 public:
@@ -51,12 +84,96 @@ public:
 //	int Count(Ipv4Address,Ipv4Address)const;
 	void Add(Ipv4Address,Ipv4Address,Ptr<Ipv4Route>);
 	void Add(Ipv4Address,Ipv4Address,Ipv4Route);
+	void Add(Ipv4Address,Ipv4Address,const NextHopGroup&);
 	Ptr<Ipv4Route> Get(Ipv4Address,Ipv4Address);
+	Ptr<Ipv4Route> Get(Ipv4Address,Ipv4Address,uint32_t);
 	void Delete(Ipv4Address,Ipv4Address);
 
+	//destination-only entries, consulted when no (src,dst) entry matches
+	void AddDestination(Ipv4Address,Ptr<Ipv4Route>);
+	void DeleteDestination(Ipv4Address);
+
+	//loop-free alternate used while the selected next hop's device is down
+	void SetBackup(Ipv4Address,Ipv4Address,Ptr<Ipv4Route>);
+	void SetDeviceUp(Ptr<NetDevice>,bool);
+	bool IsDeviceUp(Ptr<NetDevice>)const;
+	bool IsUsable(Ptr<Ipv4Route>)const;
+
+	//drop every next hop leaving through the device: groups lose the member,
+	//a group left empty falls back to its backup or is deleted; returns the
+	//number of entries touched
+	uint32_t PurgeDevice(Ptr<NetDevice>);
+
+private:
+	typedef std::pair<Ipv4Address,Ipv4Address> FlowKey;
+	void Index(const FlowKey&,bool);
+	void IndexDestination(Ipv4Address,bool);
+
+	std::map<std::pair<Ipv4Address,Ipv4Address>,NextHopGroup> m_table;
+	std::map<std::pair<Ipv4Address,Ipv4Address>,Ptr<Ipv4Route>> m_backup;
+	std::map<Ipv4Address,Ptr<Ipv4Route>> m_dstTable;
+	std::set<Ptr<NetDevice>> m_downDevices;
+
+	//device -> entries with a member or a backup leaving through it
+	std::map<Ptr<NetDevice>,std::set<FlowKey>> m_deviceFlows;
+	std::map<Ptr<NetDevice>,std::set<Ipv4Address>> m_deviceDsts;
+};
+
+//picks the member of a next-hop group each packet of a flow leaves on
+//  FLOW_HASH    all packets of a flow on the member its hash selects
+//  ROUND_ROBIN  successive packets of a flow on successive members, in
+//               proportion to the member weights
+//  FLOWLET      a flow stays on its member until it pauses for longer than
+//               the flowlet gap, then moves to the member of a fresh hash
+//packets are counted under the mode that was active when they were handled
+class PathSprayer
+{
+public:
+	enum Mode
+	{
+		FLOW_HASH,
+		ROUND_ROBIN,
+		FLOWLET
+	};
+	static const uint32_t MODE_COUNT = 3;
+
+	PathSprayer();
+	void SetMode(Mode);
+	Mode GetMode()const;
+	void SetFlowletGap(Time);
+	Time GetFlowletGap()const;
+
+	//'flow' is the flow hash, 'bytes' the packet size, counted as sent
+	Ptr<Ipv4Route> Select(FlowTable&,Ipv4Address src,Ipv4Address dst,uint32_t flow,uint32_t bytes,Time now);
+	//a packet of 'flow' reached its destination; packet uids grow in the
+	//order the packets were created, a smaller one than seen before is late
+	void Deliver(uint32_t flow,uint64_t uid,uint32_t bytes,Time now);
+
+	const SprayStats& GetStats(Mode)const;
+
 private:
-	std::map<std::pair<Ipv4Address,Ipv4Address>,Ptr<Ipv4Route>> m_table;
+	struct FlowState
+	{
+		Time last;
+		uint32_t sent = 0;
+		uint32_t flowlet = 0;
+		Ptr<Ipv4Route> route;
+	};
+	struct DeliveryState
+	{
+		uint64_t uid = 0;		//highest uid delivered
+		Time last;
+	};
+	void Prune(Time now);
+	void PruneDelivered(Time now);
 
+	Mode m_mode;
+	Time m_gap;
+	std::unordered_map<uint32_t,FlowState> m_flows;		//ROUND_ROBIN and FLOWLET only
+	size_t m_pruneAt;
+	std::unordered_map<uint32_t,DeliveryState> m_delivered;
+	size_t m_deliveredPruneAt;
+	SprayStats m_stats[MODE_COUNT];
 };
 
 
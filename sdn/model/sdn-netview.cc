@@ -1,8 +1,9 @@
 #include "sdn-netview.h"
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <chrono>
 
-extern std::map<ns3::Ptr<ns3::Node>,int> NODETOIND;
-extern std::map<int,ns3::Ptr<ns3::Node>> INDTONODE;
-extern std::map<ns3::Ipv4Address,int> ADDTOIND;
 
 namespace ns3 {
 
@@ -12,6 +13,144 @@ namespace sdn {
 
 class RoutingProtocol;
 
+NS_OBJECT_ENSURE_REGISTERED (ControlCenter);
+
+TypeId
+ControlCenter::GetTypeId(void)
+{
+  static TypeId tid = TypeId ("ns3::sdn::ControlCenter")
+      .SetParent<ObjectBase>()
+      .SetGroupName ("SDN")
+      .AddAttribute ("RoutingMetric",
+                     "Edge cost minimised by the controller's path computation.",
+                     EnumValue (DELAY),
+                     MakeEnumAccessor (&ControlCenter::m_metric),
+                     MakeEnumChecker (DELAY, "Delay",
+                                      HOP_COUNT, "HopCount",
+                                      LOAD_DELAY, "LoadDelay",
+                                      RESIDUAL_BANDWIDTH, "ResidualBandwidth"))
+      .AddAttribute ("BatchWindow",
+                     "RREQs arriving within this window are answered together, zero answers each at once.",
+                     TimeValue (Seconds (0)),
+                     MakeTimeAccessor (&ControlCenter::m_batchWindow),
+                     MakeTimeChecker ())
+      .AddAttribute ("Proactive",
+                     "Push destination-based tables to every switch at startup and after topology changes.",
+                     BooleanValue (false),
+                     MakeBooleanAccessor (&ControlCenter::m_proactive),
+                     MakeBooleanChecker ())
+      .AddAttribute ("ProactiveHoldDown",
+                     "Delay between a topology change and the table recomputation it triggers.",
+                     TimeValue (MilliSeconds (100)),
+                     MakeTimeAccessor (&ControlCenter::m_proactiveHold),
+                     MakeTimeChecker ())
+      .AddAttribute ("HelloServiceTime",
+                     "Controller time spent on one hello report.",
+                     TimeValue (Seconds (0)),
+                     MakeTimeAccessor (&ControlCenter::m_helloService),
+                     MakeTimeChecker ())
+      .AddAttribute ("RreqServiceTime",
+                     "Controller time spent on one RREQ, path computation excluded.",
+                     TimeValue (Seconds (0)),
+                     MakeTimeAccessor (&ControlCenter::m_rreqService),
+                     MakeTimeChecker ())
+      .AddAttribute ("PathServiceTime",
+                     "Extra controller time for a RREQ whose path is not known yet.",
+                     TimeValue (Seconds (0)),
+                     MakeTimeAccessor (&ControlCenter::m_pathService),
+                     MakeTimeChecker ())
+      .AddAttribute ("QueueLimit",
+                     "Requests the controller holds at once, further ones are dropped; zero means unbounded.",
+                     UintegerValue (0),
+                     MakeUintegerAccessor (&ControlCenter::m_queueLimit),
+                     MakeUintegerChecker<uint32_t> ())
+      .AddAttribute ("MeasureCompute",
+                     "Charge the wall-clock time of path computations as simulated controller time. "
+                     "The replies of a computation leave once it is over and queued jobs are postponed by it.",
+                     BooleanValue (false),
+                     MakeBooleanAccessor (&ControlCenter::m_measureCompute),
+                     MakeBooleanChecker ())
+      .AddAttribute ("Hierarchical",
+                     "Compute paths per controller domain and stitch inter-domain paths over the border graph.",
+                     BooleanValue (false),
+                     MakeBooleanAccessor (&ControlCenter::m_hierarchical),
+                     MakeBooleanChecker ())
+      .AddAttribute ("InBand",
+                     "Carry control messages as packets on the SDN_PORT sockets along the control paths.",
+                     BooleanValue (false),
+                     MakeBooleanAccessor (&ControlCenter::m_inBand),
+                     MakeBooleanChecker ())
+      .AddAttribute ("SourceRouting",
+                     "Answer a RREQ with the whole path, sent to the ingress switch only, instead of per-hop entries.",
+                     BooleanValue (false),
+                     MakeBooleanAccessor (&ControlCenter::m_sourceRouting),
+                     MakeBooleanChecker ())
+      .AddAttribute ("PathCount",
+                     "Number of loop-free paths merged into the next-hop groups of a flow.",
+                     UintegerValue (1),
+                     MakeUintegerAccessor (&ControlCenter::m_k),
+                     MakeUintegerChecker<uint32_t> (1))
+      .AddAttribute ("RepairHoldTime",
+                     "Shortest time between two repairs of one flow for the same requesting switch.",
+                     TimeValue (MilliSeconds (100)),
+                     MakeTimeAccessor (&ControlCenter::m_repairHold),
+                     MakeTimeChecker ())
+      ;
+  return tid;
+}
+
+TypeId
+ControlCenter::GetInstanceTypeId(void)const
+{
+  return GetTypeId ();
+}
+
+void
+ControlCenter::LoadDefaults()
+{
+  ConstructSelf (AttributeConstructionList ());
+}
+
+ControlCenter::ControlCenter()
+  : m_num (0),
+    m_k (1),
+    m_metric (DELAY),
+    m_batchWindow (Seconds (0)),
+    m_topoVersion (0),
+    m_treeComputations (0),
+    m_proactive (false),
+    m_proactiveHold (MilliSeconds (100)),
+    m_proactiveVersion (0),
+    m_tableUpdates (0),
+    m_tableEntries (0),
+    m_helloService (Seconds (0)),
+    m_rreqService (Seconds (0)),
+    m_pathService (Seconds (0)),
+    m_queueLimit (0),
+    m_measureCompute (false),
+    m_busyUntil (Seconds (0)),
+    m_jobs (0),
+    m_computing (false),
+    m_computeTime (Seconds (0)),
+    m_computeAdded (Seconds (0)),
+    m_rreqDrops (0),
+    m_helloDrops (0),
+    m_rreqUnknown (0),
+    m_hierarchical (false),
+    m_domainRebuild (true),
+    m_domainMetric (DELAY),
+    m_inBand (false),
+    m_sourceRouting (false),
+    m_repairHold (MilliSeconds (100)),
+    m_repairs (0),
+    m_reroutes (0),
+    m_repairsHeld (0),
+    m_pendingDrops (0),
+    m_linkFailures (0),
+    m_flowsRerouted (0)
+{
+}
+
 
 
 void
@@ -23,9 +162,22 @@ ControlCenter::SetController(int i)
       temp.push_back(i);
       m_controllers[i] = temp;
       m_swcTocon[i] = i;
+      ++m_topoVersion;
+      m_domainRebuild = true;
+      InvalidateControlDelay(i);
     }
 }
 
+void
+ControlCenter::ClearControllers()
+{
+  m_controllers.clear();
+  m_swcTocon.clear();
+  ++m_topoVersion;
+  m_domainRebuild = true;
+  m_conDelayValid.assign(m_conDelayValid.size(),false);
+}
+
 void
 ControlCenter::AddSwitchToController(int swc, int con)
 {
@@ -39,42 +191,367 @@ ControlCenter::AddSwitchToController(int swc, int con)
     }
   m_controllers[con].push_back(swc);
   m_swcTocon[swc] = con;
+  ++m_topoVersion;
+  m_domainRebuild = true;
+  InvalidateControlDelay(swc);
   return;
 }
 
 Time
 ControlCenter::CalculateDelay(int swc)
 {
+  if(swc < (int)m_conDelayValid.size() && m_conDelayValid[swc])
+    {
+      return m_conDelay[swc];
+    }
+  RefreshControlDelay(swc);
+  return m_conDelay[swc];
+}
+
+void
+ControlCenter::RefreshControlDelay(int swc)
+{
+  if((int)m_conDelay.size() <= swc)
+    {
+      int size = std::max(m_num,swc+1);
+      m_conDelay.resize(size,Seconds(0));
+      m_conDelayValid.resize(size,false);
+      m_conPath.resize(size);
+    }
+
+  //control paths live in m_conPath only, m_path holds the data flows
   int con = m_swcTocon[swc];
-  std::vector<int> path;
-  if(IsExistPath(swc,con))
+  std::vector<int> path = m_conPath[swc];
+  if(path.empty() || path.front() != swc || path.back() != con || !IsPathUp(path.begin(),path.end()))
   {
-	  path = m_path.find({swc,con})->second;
+	  path = CalculatePath(swc,con);
   }
-  else
+
+  //move the switch from the edges of its old control path to the new one
+  const std::vector<int>& old_path = m_conPath[swc];
+  for(uint32_t i = 0; i + 1 < old_path.size(); ++i)
   {
-	  path = CalculatePath(swc,con);
-	  m_path[{swc,con}] = path;
+	  m_conEdges[{old_path[i],old_path[i+1]}].erase(swc);
   }
   Time t = Seconds(0);
-  for(auto it = path.begin(); it != path.end()-1; ++it)
+  for(uint32_t i = 0; i + 1 < path.size(); ++i)
   {
-	  t = t + m_edges[{*it,*(it+1)}].delay;
+	  t = t + m_edges[{path[i],path[i+1]}].delay;
+	  m_conEdges[{path[i],path[i+1]}].insert(swc);
   }
+  m_conPath[swc] = path;
+  m_conDelay[swc] = t;
+  m_conDelayValid[swc] = true;
+}
 
-//   = CalculatePath(swc,con);
-  /*
-   *
-   *
-   *
-   *
-   */
+void
+ControlCenter::InvalidateControlDelay(int swc)
+{
+  if(swc < (int)m_conDelayValid.size())
+    {
+      m_conDelayValid[swc] = false;
+    }
+}
 
-  return t;
+int
+ControlCenter::GetController(int swc)const
+{
+  auto it = m_swcTocon.find(swc);
+  return it == m_swcTocon.end() ? -1 : it->second;
+}
+
+int
+ControlCenter::GetControlNextHop(int at, int swc, bool up)
+{
+  //in-band control messages follow the control path of 'swc',
+  //up towards its controller or down towards the switch
+  if(GetController(swc) == -1) return -1;
+  CalculateDelay(swc);
+  const std::vector<int>& path = m_conPath[swc];
+  for(uint32_t i = 0; i < path.size(); ++i)
+    {
+      if(path[i] != at) continue;
+      if(up) return i + 1 < path.size() ? path[i+1] : -1;
+      return i > 0 ? path[i-1] : -1;
+    }
+  return -1;
+}
+
+void
+ControlCenter::SendToSwitch(int swc, ControlHeader header)
+{
+  int con = GetController(swc);
+  if(con == -1) return;
+  header.SetRoute(con,swc,false);
+  //the message leaves the controller once the computation behind it is over
+  Ptr<RoutingProtocol> rp = RoutingProtocol::REGISTRY.GetNode(con)->GetObject<RoutingProtocol>();
+  Simulator::Schedule(ComputeCharge(),&RoutingProtocol::SendControl,rp,header);
+}
+
+bool
+ControlCenter::IsServerModelled()const
+{
+  return !m_helloService.IsZero() || !m_rreqService.IsZero() || !m_pathService.IsZero()
+      || m_queueLimit > 0 || m_measureCompute;
+}
+
+bool
+ControlCenter::Admit(Time service, Time& wait)
+{
+  //single FIFO server: a job starts when the previous one is finished
+  if(m_queueLimit > 0 && m_jobs >= m_queueLimit)
+    {
+      return false;
+    }
+  Time start = std::max(Simulator::Now(),m_busyUntil);
+  m_busyUntil = start + service;
+  wait = m_busyUntil - Simulator::Now();
+  ++m_jobs;
+  return true;
+}
+
+void
+ControlCenter::BeginCompute()
+{
+  m_computing = true;
+  m_computeStart = std::chrono::steady_clock::now();
+}
+
+void
+ControlCenter::EndCompute()
+{
+  if(m_measureCompute)
+    {
+      //the server stays busy for the real time the computation took, the
+      //jobs waiting behind it start that much later
+      Time charge = ComputeCharge();
+      m_computeTime += charge;
+      if(m_jobs > 0)
+        {
+          m_computeAdded += charge;
+        }
+      m_busyUntil = std::max(m_busyUntil,Simulator::Now()) + charge;
+    }
+  m_computing = false;
+}
+
+Time
+ControlCenter::ComputeCharge()const
+{
+  if(!m_measureCompute || !m_computing) return Seconds(0);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_computeStart;
+  return Seconds(elapsed.count());
+}
+
+Time
+ControlCenter::ReplyDelay(int swc)
+{
+  return CalculateDelay(swc) + ComputeCharge();
 }
 
 void
 ControlCenter::RecvRREQ(int req,Ipv4Address src ,Ipv4Address dst)
+{
+  //no path can be computed to or from an address no node registered
+  int src_ind = SourceIndex(req,src);
+  int dst_ind = RoutingProtocol::REGISTRY.GetIndex(dst);
+  if(src_ind == -1 || dst_ind == -1)
+    {
+      ++m_rreqUnknown;
+      return;
+    }
+  if(!IsServerModelled())
+    {
+      HandleRREQ(req,src,dst);
+      return;
+    }
+  Time service = m_rreqService;
+  if(!IsExistPath(src_ind,dst_ind))
+    {
+      service = service + m_pathService;
+    }
+  Time wait;
+  if(!Admit(service,wait))
+    {
+      ++m_rreqDrops;
+      return;
+    }
+  Simulator::Schedule(wait,&ControlCenter::ServeRREQ,this,req,src,dst,m_computeAdded);
+}
+
+bool
+ControlCenter::Postpone(Time admitted, Time& wait)
+{
+  //computations charged while a job waited push its start back by their time
+  if(m_computeAdded == admitted)
+    {
+      return false;
+    }
+  wait = m_computeAdded - admitted;
+  return true;
+}
+
+void
+ControlCenter::ServeRREQ(int req,Ipv4Address src ,Ipv4Address dst,Time admitted)
+{
+  Time wait;
+  if(Postpone(admitted,wait))
+    {
+      Simulator::Schedule(wait,&ControlCenter::ServeRREQ,this,req,src,dst,m_computeAdded);
+      return;
+    }
+  --m_jobs;
+  HandleRREQ(req,src,dst);
+}
+
+void
+ControlCenter::HandleRREQ(int req,Ipv4Address src ,Ipv4Address dst)
+{
+  if(m_batchWindow.IsZero())
+    {
+      BeginCompute();
+      ProcessRREQ(req,src,dst);
+      EndCompute();
+      return;
+    }
+  //hold the request until the window closes, the whole batch is answered at once
+  PendingRreq rreq;
+  rreq.req = req;
+  rreq.src = src;
+  rreq.dst = dst;
+  m_batch.push_back(rreq);
+  if(!m_batchEvent.IsRunning())
+    {
+      m_batchEvent = Simulator::Schedule(m_batchWindow,&ControlCenter::FlushRreqBatch,this);
+    }
+}
+
+int
+ControlCenter::SourceIndex(int req, Ipv4Address src)const
+{
+  if(src.IsInitialized())
+    {
+      return RoutingProtocol::REGISTRY.GetIndex(src);
+    }
+  return req;
+}
+
+void
+ControlCenter::FlushRreqBatch()
+{
+  BeginCompute();
+  std::map<int,std::vector<PendingRreq>> by_source;
+  for(auto it = m_batch.begin(); it != m_batch.end(); ++it)
+    {
+      by_source[SourceIndex(it->req,it->src)].push_back(*it);
+    }
+  m_batch.clear();
+
+  //one shortest-path tree per source answers all of its destinations,
+  //the hops are then collected per switch and delivered together; the
+  //costs towards each destination give the loop-free alternates
+  std::map<int,std::vector<FlowInstall>> installs;
+  std::map<int,std::set<std::pair<int,int>>> flows_at;
+  std::map<int,std::vector<double>> to_dsts;
+  for(auto it = by_source.begin(); it != by_source.end(); ++it)
+    {
+      int src_ind = it->first;
+      for(auto rreq = it->second.begin(); rreq != it->second.end(); ++rreq)
+        {
+          int dst_ind = RoutingProtocol::REGISTRY.GetIndex(rreq->dst);
+          if(flows_at[src_ind].count({src_ind,dst_ind}))
+            {
+              //asked again before this batch answered it
+              ++m_pendingDrops;
+              continue;
+            }
+          if(m_k > 1 || m_sourceRouting || IsExistPath(src_ind,dst_ind))
+            {
+              ProcessRREQ(rreq->req,rreq->src,rreq->dst);
+              continue;
+            }
+          std::vector<int> path = CalculatePath(src_ind,dst_ind);
+          if(path.empty()) continue;
+
+          Ipv4Address src = rreq->src;
+          if(rreq->req == src_ind)
+            {
+              src = RoutingProtocol::REGISTRY.GetNode(src_ind)->GetObject<RoutingProtocol>()->GetDefaultSourceAddress();
+            }
+          SetFlowPath(src_ind,dst_ind,path);
+          m_flowAddresses[{src_ind,dst_ind}] = std::make_pair(src,rreq->dst);
+          std::map<int,std::vector<double>>::iterator to_dst = to_dsts.find(dst_ind);
+          if(to_dst == to_dsts.end())
+            {
+              to_dst = to_dsts.insert(std::make_pair(dst_ind,CostsTo(dst_ind))).first;
+            }
+          std::map<int,std::map<int,double>> groups = BuildNextHopGroups(std::vector<std::vector<int>>(1,path),to_dst->second);
+          std::map<int,int> backups = BackupNextHops(groups,to_dst->second);
+          for(uint32_t i = 0; i + 1 < path.size(); ++i)
+            {
+              FlowInstall install;
+              install.src = src;
+              install.dst = rreq->dst;
+              install.next = path[i+1];
+              auto backup = backups.find(path[i]);
+              if(backup != backups.end())
+                {
+                  install.backup = backup->second;
+                  AddFlowEdges(src_ind,dst_ind,std::vector<int>{path[i],backup->second});
+                }
+              installs[path[i]].push_back(install);
+              flows_at[path[i]].insert({src_ind,dst_ind});
+            }
+        }
+    }
+
+  for(auto it = installs.begin(); it != installs.end(); ++it)
+    {
+      Time delay = ReplyDelay(it->first);
+      const std::set<std::pair<int,int>>& flows_here = flows_at[it->first];
+      for(auto flow = flows_here.begin(); flow != flows_here.end(); ++flow)
+        {
+          ExpectReply(flow->first,flow->second,Simulator::Now() + delay);
+        }
+      if(m_inBand)
+        {
+          std::vector<FlowEntry> flows;
+          for(auto install = it->second.begin(); install != it->second.end(); ++install)
+            {
+              FlowEntry flow;
+              flow.src = install->src;
+              flow.dst = install->dst;
+              flow.nexts.push_back(std::make_pair(install->next,1.0));
+              flow.backup = install->backup;
+              flows.push_back(flow);
+            }
+          ControlHeader header(SDNTYPE_RREP);
+          header.SetFlows(flows);
+          SendToSwitch(it->first,header);
+          continue;
+        }
+      Ptr<RoutingProtocol> rp = RoutingProtocol::REGISTRY.GetNode(it->first)->GetObject<RoutingProtocol>();
+      Simulator::Schedule(delay,&RoutingProtocol::RecvRREPBatch,rp,it->second);
+    }
+  EndCompute();
+}
+
+std::vector<int>
+ControlCenter::PathFromTree(const std::vector<int>& prev, int src, int dst)const
+{
+  std::vector<int> path;
+  if(dst < 0 || dst >= (int)prev.size()) return path;
+  if(dst != src && prev[dst] == -1) return path;
+  for(int cur = dst; cur != -1; cur = prev[cur])
+    {
+      path.push_back(cur);
+    }
+  std::reverse(path.begin(),path.end());
+  return path;
+}
+
+void
+ControlCenter::ProcessRREQ(int req,Ipv4Address src ,Ipv4Address dst)
 {
   //RREQ is from 'req'
   //To request req's route of the flow from 'src' to 'dst'
@@ -82,367 +559,944 @@ ControlCenter::RecvRREQ(int req,Ipv4Address src ,Ipv4Address dst)
   //the nodes on the flow between 'src' and 'dst' have know route
   //but a RREQ generated
 
-	int src_ind;
-	if(src.IsInitialized())
-		src_ind = ADDTOIND.find(src)->second;
-	else
-		src_ind = req;
+	int src_ind = SourceIndex(req,src);
 
-	int dst_ind = ADDTOIND.find(dst)->second;
+	int dst_ind = RoutingProtocol::REGISTRY.GetIndex(dst);
   if(IsExistPath(src_ind,dst_ind))
     {
-      for(auto it = m_path[{src_ind,dst_ind}].begin();
-          it != m_path[{src_ind,dst_ind}].end();
-              ++it)
-        {
-          if(*it == req)
-            {
-              //the node on the path do not know the route
-              /*
-               *
-               */
-              return;
-            }
-        }
-      //the node 'req' is not on the path
-      //exist a node on the path before 'req' transmit to the wrong way
-      /*
-       *
-       */
+      RepairFlow(req,src,dst,src_ind,dst_ind);
       return;
     }
   //A new flow request from 'src' to 'dst', requested by 'req'
   // 'req' == 'src'
-  std::vector<int> path = CalculatePath(src_ind,dst_ind);
-  m_path[{src_ind,dst_ind}] = path;
-  Ptr<Node> no;
+  if(m_sourceRouting)
+  {
+	  std::vector<int> path = CalculatePath(src_ind,dst_ind);
+	  if(path.empty()) return;
+	  Ptr<RoutingProtocol> rp = RoutingProtocol::REGISTRY.GetNode(req)->GetObject<RoutingProtocol>();
+	  if(req == src_ind)
+	  {
+		  src = rp->GetDefaultSourceAddress();
+	  }
+	  SetFlowPath(src_ind,dst_ind,path);
+	  m_flowAddresses[{src_ind,dst_ind}] = std::make_pair(src,dst);
+	  ExpectReply(src_ind,dst_ind,Simulator::Now() + ReplyDelay(req));
+	  if(m_inBand)
+	  {
+		  ControlHeader header(SDNTYPE_PATH);
+		  header.SetRequest(src,dst);
+		  header.SetPath(path);
+		  SendToSwitch(req,header);
+		  return;
+	  }
+	  Simulator::Schedule(ReplyDelay(req),&RoutingProtocol::RecvSourceRoute,rp,src,dst,path);
+	  return;
+  }
+  std::vector<std::vector<int>> paths = CalculateKPaths(src_ind,dst_ind,m_k);
+  if(paths.empty()) return;
+  std::vector<int> path = paths.front();
   Ptr<RoutingProtocol> rp;
-  Time time;
 
   if(req == src_ind)
   {
-	  src = INDTONODE.find(*path.begin())->second->GetObject<RoutingProtocol>()->GetDefaultSourceAddress();
+	  src = RoutingProtocol::REGISTRY.GetNode(*path.begin())->GetObject<RoutingProtocol>()->GetDefaultSourceAddress();
   }
+  SetFlowPath(src_ind,dst_ind,path);
+  m_flowAddresses[{src_ind,dst_ind}] = std::make_pair(src,dst);
 
-
-  for(auto it = path.begin(); it != path.end()-1; ++it)
+  //every switch on any of the paths gets its share of next hops; the entries
+  //wait in the switch's install queue until their arrival time, and only the
+  //requesting switch gets an event to release its parked packets
+  std::vector<double> to_dst = CostsTo(dst_ind);
+  std::map<int,std::map<int,double>> groups = BuildNextHopGroups(paths,to_dst);
+  std::map<int,int> backups = BackupNextHops(groups,to_dst);
+  for(auto it = groups.begin(); it != groups.end(); ++it)
   {
-	  no = INDTONODE.find(*it)->second;
-	  rp = no->GetObject<RoutingProtocol>();
-	  time = CalculateDelay(*it);
-	  Simulator::Schedule(time,&RoutingProtocol::RecvRREP,rp,src,dst,*(it+1));
+	  std::vector<std::pair<int,double>> nexts(it->second.begin(),it->second.end());
+	  auto backup = backups.find(it->first);
+	  //a failure of any member or of the backup moves the flow, not only
+	  //one on the stored path
+	  for(auto next = nexts.begin(); next != nexts.end(); ++next)
+	  {
+		  AddFlowEdges(src_ind,dst_ind,std::vector<int>{it->first,next->first});
+	  }
+	  if(backup != backups.end())
+	  {
+		  AddFlowEdges(src_ind,dst_ind,std::vector<int>{it->first,backup->second});
+	  }
+	  Time at = Simulator::Now() + ReplyDelay(it->first);
+	  ExpectReply(src_ind,dst_ind,at);
+	  if(m_inBand)
+	  {
+		  //every switch releases its parked packets once its entry arrives
+		  FlowEntry flow;
+		  flow.src = src;
+		  flow.dst = dst;
+		  flow.nexts = nexts;
+		  flow.backup = backup == backups.end() ? -1 : backup->second;
+		  ControlHeader header(SDNTYPE_RREP);
+		  header.SetFlows(std::vector<FlowEntry>(1,flow));
+		  SendToSwitch(it->first,header);
+		  continue;
+	  }
+	  rp = RoutingProtocol::REGISTRY.GetNode(it->first)->GetObject<RoutingProtocol>();
+	  rp->QueueInstall(at,src,dst,nexts,
+			  backup == backups.end() ? -1 : backup->second);
   }
+  if(m_inBand) return;
+  rp = RoutingProtocol::REGISTRY.GetNode(req)->GetObject<RoutingProtocol>();
+  Simulator::Schedule(ReplyDelay(req),&RoutingProtocol::ReleaseFlow,rp,src,dst);
   return;
 }
 
-bool
-ControlCenter::IsController(int i)const
+void
+ControlCenter::RepairFlow(int req,Ipv4Address src ,Ipv4Address dst,int src_ind,int dst_ind)
+{
+  //the flow has a path but 'req' asks again. Packets queued before the
+  //entries sent for the flow arrived ask too, they are served by them
+  if(IsReplyPending(src_ind,dst_ind))
+    {
+      ++m_pendingDrops;
+      return;
+    }
+  //after that the entry of 'req' was lost, or it is off the path since the
+  //topology changed; one switch is answered once per hold time
+  auto key = std::make_tuple(req,src_ind,dst_ind);
+  auto last = m_repaired.find(key);
+  if(last != m_repaired.end() && Simulator::Now() - last->second < m_repairHold)
+    {
+      ++m_repairsHeld;
+      return;
+    }
+  m_repaired[key] = Simulator::Now();
+
+  std::vector<int> path = m_path[{src_ind,dst_ind}];
+  std::vector<int>::iterator pos = std::find(path.begin(),path.end(),req);
+  if(pos != path.end() && IsPathUp(pos,path.end()))
+    {
+      //on an intact path only the hop of 'req' is missing, the switches
+      //after it ask for their own if they lost them too
+      ++m_repairs;
+      ExpectReply(src_ind,dst_ind,PushHops(req,src,dst,std::vector<int>(pos,path.end()),m_sourceRouting ? 0 : 1));
+      return;
+    }
+
+  std::vector<int> hops = CalculatePath(req,dst_ind);
+  if(hops.empty()) return;
+  ++m_reroutes;
+  if(pos != path.end())
+    {
+      //'req' keeps its place, the part of the path behind it is replaced
+      path.erase(pos,path.end());
+      path.insert(path.end(),hops.begin(),hops.end());
+      SetFlowPath(src_ind,dst_ind,path);
+    }
+  else if(req == src_ind)
+    {
+      SetFlowPath(src_ind,dst_ind,hops);
+    }
+  else
+    {
+      //'req' is off the path, the branch it is given belongs to the flow too
+      AddFlowEdges(src_ind,dst_ind,hops);
+    }
+  ExpectReply(src_ind,dst_ind,PushHops(req,src,dst,hops,0));
+}
+
+Time
+ControlCenter::PushHops(int req,Ipv4Address src ,Ipv4Address dst,const std::vector<int>& hops,uint32_t count)
+{
+  //send the first 'count' hops of 'hops' (all of them for zero), which
+  //starts at 'req', and release the packets 'req' holds for the flow;
+  //returns when the last of them arrives
+  Time due = Simulator::Now();
+  if(hops.size() < 2) return due;
+  Ptr<RoutingProtocol> rp = RoutingProtocol::REGISTRY.GetNode(req)->GetObject<RoutingProtocol>();
+  if(!src.IsInitialized() || RoutingProtocol::REGISTRY.GetIndex(src) == req)
+    {
+      src = rp->GetDefaultSourceAddress();
+    }
+  if(m_sourceRouting)
+    {
+      Time delay = ReplyDelay(req);
+      if(m_inBand)
+        {
+          ControlHeader header(SDNTYPE_PATH);
+          header.SetRequest(src,dst);
+          header.SetPath(hops);
+          SendToSwitch(req,header);
+          return due + delay;
+        }
+      Simulator::Schedule(delay,&RoutingProtocol::RecvSourceRoute,rp,src,dst,hops);
+      return due + delay;
+    }
+  uint32_t last = count == 0 ? hops.size() - 1 : std::min<uint32_t>(count,hops.size() - 1);
+  for(uint32_t i = 0; i < last; ++i)
+    {
+      std::vector<std::pair<int,double>> nexts(1,std::make_pair(hops[i+1],1.0));
+      Time at = Simulator::Now() + ReplyDelay(hops[i]);
+      due = std::max(due,at);
+      if(m_inBand)
+        {
+          FlowEntry flow;
+          flow.src = src;
+          flow.dst = dst;
+          flow.nexts = nexts;
+          ControlHeader header(SDNTYPE_RREP);
+          header.SetFlows(std::vector<FlowEntry>(1,flow));
+          SendToSwitch(hops[i],header);
+          continue;
+        }
+      Ptr<RoutingProtocol> hop = RoutingProtocol::REGISTRY.GetNode(hops[i])->GetObject<RoutingProtocol>();
+      hop->QueueInstall(at,src,dst,nexts);
+    }
+  if(m_inBand) return due;
+  Simulator::Schedule(ReplyDelay(req),&RoutingProtocol::ReleaseFlow,rp,src,dst);
+  return due;
+}
+
+void
+ControlCenter::ExpectReply(int src_ind,int dst_ind,Time at)
+{
+  Time& due = m_replyDue[{src_ind,dst_ind}];
+  due = std::max(due,at);
+}
+
+bool
+ControlCenter::IsReplyPending(int src_ind,int dst_ind)const
+{
+  auto due = m_replyDue.find({src_ind,dst_ind});
+  return due != m_replyDue.end() && Simulator::Now() < due->second;
+}
+
+bool
+ControlCenter::IsPathUp(std::vector<int>::const_iterator begin,std::vector<int>::const_iterator end)const
+{
+  for(std::vector<int>::const_iterator it = begin; it != end && it + 1 != end; ++it)
+    {
+      if(*it >= m_num || *(it+1) >= m_num || m_G[*it][*(it+1)] != 1) return false;
+    }
+  return true;
+}
+
+void
+ControlCenter::SetFlowPath(int src_ind,int dst_ind,const std::vector<int>& path)
+{
+  //keep the edge -> flows index in step with the stored path, the edges
+  //of the old path and of any branch added to it are dropped
+  std::pair<int,int> key(src_ind,dst_ind);
+  auto old = m_edgesOfFlow.find(key);
+  if(old != m_edgesOfFlow.end())
+    {
+      for(auto edge = old->second.begin(); edge != old->second.end(); ++edge)
+        {
+          auto it = m_flowEdges.find(*edge);
+          if(it == m_flowEdges.end()) continue;
+          it->second.erase(key);
+          if(it->second.empty()) m_flowEdges.erase(it);
+        }
+      m_edgesOfFlow.erase(old);
+    }
+  m_path[key] = path;
+  AddFlowEdges(src_ind,dst_ind,path);
+}
+
+void
+ControlCenter::AddFlowEdges(int src_ind,int dst_ind,const std::vector<int>& hops)
+{
+  std::pair<int,int> key(src_ind,dst_ind);
+  for(uint32_t i = 0; i + 1 < hops.size(); ++i)
+    {
+      std::pair<int,int> edge(hops[i],hops[i+1]);
+      m_flowEdges[edge].insert(key);
+      m_edgesOfFlow[key].insert(edge);
+    }
+}
+
+void
+ControlCenter::RecvLinkChange(int from,int to,bool up,Time detected)
+{
+  if(from < 0 || to < 0 || from >= m_num || to >= m_num || (int)m_G.size() != m_num) return;
+  int val = up ? 1 : -1;
+  if(m_G[from][to] == val && m_G[to][from] == val) return;
+  //a link is usable in both directions or in neither
+  ChangeG(from,to,val);
+  ChangeG(to,from,val);
+  if(up) return;
+
+  BeginCompute();
+  ++m_linkFailures;
+  std::set<std::pair<int,int>> flows;
+  std::set<int> switches;
+  for(int dir = 0; dir < 2; ++dir)
+    {
+      std::pair<int,int> edge = dir ? std::make_pair(to,from) : std::make_pair(from,to);
+      auto fit = m_flowEdges.find(edge);
+      if(fit != m_flowEdges.end()) flows.insert(fit->second.begin(),fit->second.end());
+      auto cit = m_conEdges.find(edge);
+      if(cit != m_conEdges.end()) switches.insert(cit->second.begin(),cit->second.end());
+    }
+
+  //control paths over the link are recomputed on their next use
+  for(auto swc = switches.begin(); swc != switches.end(); ++swc)
+    {
+      InvalidateControlDelay(*swc);
+    }
+
+  //only the flows routed over the link get a new path; one that cannot be
+  //rerouted keeps the broken one, its next request goes through RepairFlow
+  Time done = Simulator::Now();
+  for(auto flow = flows.begin(); flow != flows.end(); ++flow)
+    {
+      auto addr = m_flowAddresses.find(*flow);
+      if(addr == m_flowAddresses.end()) continue;
+      std::vector<int> path = CalculatePath(flow->first,flow->second);
+      if(path.empty()) continue;
+      SetFlowPath(flow->first,flow->second,path);
+      Time due = PushHops(flow->first,addr->second.first,addr->second.second,path,0);
+      ExpectReply(flow->first,flow->second,due);
+      ++m_flowsRerouted;
+      done = std::max(done,due);
+    }
+  //failure noticed at the switch -> last affected switch holds its new entry
+  m_reconvergence.Add(done - detected);
+  EndCompute();
+}
+
+void
+ControlCenter::InstallAllTables()
+{
+  BeginCompute();
+  if((int)m_pushed.size() != m_num)
+    {
+      m_pushed.assign(m_num,std::vector<int>(m_num,-1));
+    }
+  std::vector<std::vector<Ipv4Address>> addrs(m_num);
+  const std::vector<std::pair<Ipv4Address,int>>& all = RoutingProtocol::REGISTRY.GetAddresses();
+  for(auto it = all.begin(); it != all.end(); ++it)
+    {
+      if(it->second < m_num && !it->first.IsLocalhost())
+        {
+          addrs[it->second].push_back(it->first);
+        }
+    }
+
+  //one reverse tree per destination gives every switch its next hop towards it,
+  //only the entries that differ from the last push are sent
+  std::map<int,std::vector<FlowInstall>> tables;
+  std::vector<double> dist;
+  std::vector<int> prev;
+  for(int d = 0; d < m_num; ++d)
+    {
+      Dijkstra(d,true,std::vector<bool>(m_num,false),std::set<std::pair<int,int>>(),dist,prev);
+      for(int v = 0; v < m_num; ++v)
+        {
+          if(v == d || prev[v] == m_pushed[v][d]) continue;
+          m_pushed[v][d] = prev[v];
+          for(auto add = addrs[d].begin(); add != addrs[d].end(); ++add)
+            {
+              FlowInstall install;
+              install.dst = *add;
+              install.next = prev[v];
+              tables[v].push_back(install);
+            }
+        }
+    }
+  m_proactiveVersion = m_topoVersion;
+
+  for(auto it = tables.begin(); it != tables.end(); ++it)
+    {
+      ++m_tableUpdates;
+      m_tableEntries += it->second.size();
+      if(m_inBand)
+        {
+          ControlHeader header(SDNTYPE_TABLE);
+          header.SetEntries(it->second);
+          SendToSwitch(it->first,header);
+          continue;
+        }
+      Ptr<RoutingProtocol> rp = RoutingProtocol::REGISTRY.GetNode(it->first)->GetObject<RoutingProtocol>();
+      Simulator::Schedule(ReplyDelay(it->first),&RoutingProtocol::RecvTable,rp,it->second);
+    }
+  EndCompute();
+}
+
+void
+ControlCenter::ScheduleTableUpdate()
+{
+  if(!m_proactive || m_proactiveVersion == m_topoVersion || m_proactiveEvent.IsRunning()) return;
+  m_proactiveEvent = Simulator::Schedule(m_proactiveHold,&ControlCenter::InstallAllTables,this);
+}
+
+uint64_t
+ControlCenter::GetTableUpdates()const
+{
+  return m_tableUpdates;
+}
+
+uint64_t
+ControlCenter::GetTableEntries()const
+{
+  return m_tableEntries;
+}
+
+bool
+ControlCenter::IsController(int i)const
+{
+	return m_controllers.count(i);
+}
+
+bool
+ControlCenter::IsExistPath(int src, int dst)const
+{
+	return m_path.count({src,dst});
+}
+
+
+template <typename Metric>
+double
+ControlCenter::EdgeCost(int from, int to)const
+{
+	auto it = m_edges.find({from,to});
+	if(it == m_edges.end()) return std::numeric_limits<double>::infinity();
+	return Metric::Cost(it->second);
+}
+
+template <typename Metric>
+double
+ControlCenter::PathCost(const std::vector<int>& path)const
+{
+	double cost = 0;
+	for(uint32_t i = 0; i + 1 < path.size(); ++i)
+	{
+		cost += EdgeCost<Metric>(path[i],path[i+1]);
+	}
+	return cost;
+}
+
+double
+ControlCenter::EdgeCost(int from, int to)const
+{
+	switch(m_metric)
+	{
+	case HOP_COUNT:
+		return EdgeCost<HopMetric>(from,to);
+	case LOAD_DELAY:
+		return EdgeCost<LoadDelayMetric>(from,to);
+	case RESIDUAL_BANDWIDTH:
+		return EdgeCost<ResidualBandwidthMetric>(from,to);
+	default:
+		return EdgeCost<DelayMetric>(from,to);
+	}
+}
+
+double
+ControlCenter::EdgeCost(const Edge& edge)const
+{
+	switch(m_metric)
+	{
+	case HOP_COUNT:
+		return HopMetric::Cost(edge);
+	case LOAD_DELAY:
+		return LoadDelayMetric::Cost(edge);
+	case RESIDUAL_BANDWIDTH:
+		return ResidualBandwidthMetric::Cost(edge);
+	default:
+		return DelayMetric::Cost(edge);
+	}
+}
+
+double
+ControlCenter::PathCost(const std::vector<int>& path)const
+{
+	switch(m_metric)
+	{
+	case HOP_COUNT:
+		return PathCost<HopMetric>(path);
+	case LOAD_DELAY:
+		return PathCost<LoadDelayMetric>(path);
+	case RESIDUAL_BANDWIDTH:
+		return PathCost<ResidualBandwidthMetric>(path);
+	default:
+		return PathCost<DelayMetric>(path);
+	}
+}
+
+void
+ControlCenter::Dijkstra(int root, bool reverse, const std::vector<bool>& removed_nodes,
+		const std::set<std::pair<int,int>>& removed_edges,
+		std::vector<double>& dist, std::vector<int>& prev)const
+{
+	switch(m_metric)
+	{
+	case HOP_COUNT:
+		Dijkstra<HopMetric>(root,reverse,removed_nodes,removed_edges,dist,prev);
+		break;
+	case LOAD_DELAY:
+		Dijkstra<LoadDelayMetric>(root,reverse,removed_nodes,removed_edges,dist,prev);
+		break;
+	case RESIDUAL_BANDWIDTH:
+		Dijkstra<ResidualBandwidthMetric>(root,reverse,removed_nodes,removed_edges,dist,prev);
+		break;
+	default:
+		Dijkstra<DelayMetric>(root,reverse,removed_nodes,removed_edges,dist,prev);
+	}
+}
+
+template <typename Metric>
+void
+ControlCenter::Dijkstra(int root, bool reverse, const std::vector<bool>& removed_nodes,
+		const std::set<std::pair<int,int>>& removed_edges,
+		std::vector<double>& dist, std::vector<int>& prev)const
+{
+	//reverse == true walks the edges backwards, so 'dist' holds the cost
+	//from every node to 'root' instead of from 'root' to every node
+	dist.assign(m_num,std::numeric_limits<double>::infinity());
+	prev.assign(m_num,-1);
+
+	typedef std::pair<double,int> Item;
+	std::priority_queue<Item,std::vector<Item>,std::greater<Item>> heap;
+	dist[root] = 0;
+	heap.push({0,root});
+
+	while(!heap.empty())
+	{
+		Item top = heap.top();
+		heap.pop();
+		int u = top.second;
+		if(top.first > dist[u]) continue;
+		for(int v = 0; v < m_num; ++v)
+		{
+			int from = reverse ? v : u;
+			int to = reverse ? u : v;
+			if(m_G[from][to] != 1) continue;
+			if(removed_nodes[v] || removed_edges.count({from,to})) continue;
+			double d = dist[u] + EdgeCost<Metric>(from,to);
+			if(d < dist[v])
+			{
+				dist[v] = d;
+				prev[v] = u;
+				heap.push({d,v});
+			}
+		}
+	}
+}
+
+std::vector<int>
+ControlCenter::ShortestPath(int src, int dst, const std::vector<bool>& removed_nodes,
+		const std::set<std::pair<int,int>>& removed_edges)const
 {
-	return m_controllers.count(i);
+	std::vector<double> dist;
+	std::vector<int> prev;
+	Dijkstra(src,false,removed_nodes,removed_edges,dist,prev);
+	return PathFromTree(prev,src,dst);
 }
 
-bool
-ControlCenter::IsExistPath(int src, int dst)const
+const std::vector<int>&
+ControlCenter::SourceTree(int src)
 {
-	return m_path.count({src,dst});
+	//the predecessor tree of 'src' stays valid until the topology or the metric changes
+	SptCache& cache = m_trees[src];
+	if(cache.prev.empty() || cache.version != m_topoVersion || cache.metric != m_metric)
+	{
+		std::vector<double> dist;
+		Dijkstra(src,false,std::vector<bool>(m_num,false),std::set<std::pair<int,int>>(),dist,cache.prev);
+		++m_treeComputations;
+		cache.version = m_topoVersion;
+		cache.metric = m_metric;
+	}
+	return cache.prev;
 }
 
-
 std::vector<int>
 ControlCenter::CalculatePath(int src, int dst)
 {
-	//from <si,sj> to <di,dj>
-//	int si,sj,di,dj;
-//	si = src/NPERPLANE;
-//	sj = src%NPERPLANE;
-//	di = dst/NPERPLANE;
-//	dj = dst%NPERPLANE;
-//	int i = si;
-//	int j = sj;
-	std::vector<int> path;
-
-
-//	if(si < di)
-//	{
-//		if(sj < dj && dj-sj <= sj-dj+NPERPLANE)
-//		{
-//			/*
-//			 * 	<si,sj>
-//			 *
-//			 * 						<di,dj>
-//			 */
-//		}
-//		if(sj<dj && dj-sj > sj-dj+NPERPLANE)
-//		{
-//			/*
-//			 * 						<di,dj>
-//			 *
-//			 * 	<si,sj+NPERPLANE>
-//			 */
-//
-//
-//		}
-//		if(sj == dj)
-//		{
-//			/*
-//			 * 	<si,sj>		<di,dj>
-//			 */
-//
-//		}
-//		if(sj > dj && sj-dj <= dj-sj+NPERPLANE)
-//		{
-//			/*
-//			 * 						<di,dj>
-//			 *
-//			 * 	<si,sj>
-//			 */
-//
-//
-//
-//		}
-//		if(sj > dj && sj-dj > dj-sj+NPERPLANE)
-//		{
-//			/*
-//			 * 	<si,sj>
-//			 *
-//			 * 				<di,dj+NPERPLANE>
-//			 */
-//
-//		}
-//
-//	}
-//	if(si == di)
-//	{
-//		if(sj < dj && dj-sj <= sj-dj+NPERPLANE)
-//		{
-//			/*
-//			 * 	<si,sj>
-//			 *
-//			 * 	<di,dj>
-//			 */
-//
-//		}
-//		if(sj < dj && dj-sj > sj-dj+NPERPLANE)
-//		{
-//			/*
-//			 * 	<di,dj>
-//			 *
-//			 * 	<si,sj+NPERPLANE>
-//			 */
-//
-//		}
-//		if(sj == dj)
-//		{
-//			/*
-//			 * <si,sj> == <di,dj>
-//			 */
-//
-//		}
-//		if(sj > dj && sj-dj <= dj-sj+NPERPLANE)
-//		{
-//			/*
-//			 * 	<di,dj>
-//			 *
-//			 * 	<si,sj>
-//			 */
-//
-//		}
-//		if(sj > dj && sj-dj > dj-sj+NPERPLANE)
-//		{
-//			/*
-//			 * 	<si,sj>
-//			 *
-//			 * 	<di,dj+NPERPLANE>
-//			 */
-//
-//		}
-//	}
-//	if(si > di)
-//	{
-//		if(sj < dj && dj-sj <= sj-dj+NPERPLANE)
-//		{
-//			/*
-//			 * 						<si,sj>
-//			 *
-//			 * 	<di,dj>
-//			 *
-//			 */
-//
-//
-//		}
-//		if(sj<dj && dj-sj > sj-dj+NPERPLANE)
-//		{
-//			/*
-//			 * 	<di,dj>
-//			 *
-//			 * 						<si,sj+NPERPLANE>
-//			 */
-//
-//		}
-//		if(sj == dj)
-//		{
-//			/*
-//			 * 	<di,dj>				<si,sj>
-//			 */
-//
-//		}
-//		if(sj > dj && sj-dj <= dj-sj+NPERPLANE)
-//		{
-//			/*
-//			 * 	<di,dj>
-//			 *
-//			 * 						<si,sj>
-//			 */
-//
-//
-//		}
-//		if(sj > dj && sj-dj > dj-sj+NPERPLANE)
-//		{
-//			/*
-//			 * 						<si,sj>
-//			 *
-//			 * 	<di,dj+NPERPLANE>
-//			 */
-//
-//		}
-//	}
-
-	path.push_back(src);
-
-	/*
-	 * 	table:
-	 *
-	 * 		|path(vector)|node i ... j |
-	 * 		|path(vector)|node i ... j |
-	 * 		|path(vector)|node i ... j |
-	 * 		|path(vector)|node i ... j |
-	 *
-	 */
-
-
-	std::vector<std::pair<std::vector<int>,std::vector<double>>> table;
-	std::vector<int> flag;
-
-	std::vector<double> cost;
-	for(auto it = m_G[src].begin(); it != m_G[src].end(); ++it)
-	{
-		if(*it == 0)
-		{
-			cost.push_back(0);
-			flag.push_back(1);
-			continue;
-		}
-		if(*it == -1)
+	if(m_hierarchical && !m_controllers.empty())
+	{
+		UpdateDomains();
+		std::vector<int> path = m_domainRouter.Path(src,dst);
+		if(!path.empty()) return path;
+	}
+	return PathFromTree(SourceTree(src),src,dst);
+}
+
+void
+ControlCenter::RebuildDomains()
+{
+	//a domain is a controller and the switches assigned to it
+	std::vector<int> domain(m_num,-1);
+	for(auto it = m_swcTocon.begin(); it != m_swcTocon.end(); ++it)
+	{
+		if(it->first < m_num) domain[it->first] = it->second;
+	}
+	std::vector<DomainRouter::Link> links;
+	for(auto it = m_edges.begin(); it != m_edges.end(); ++it)
+	{
+		int from = it->first.first;
+		int to = it->first.second;
+		if(from >= m_num || to >= m_num || m_G[from][to] != 1) continue;
+		DomainRouter::Link link;
+		link.from = from;
+		link.to = to;
+		link.cost = EdgeCost(from,to);
+		links.push_back(link);
+	}
+	m_domainRouter.Build(domain,links);
+	m_domainRebuild = false;
+	m_domainMetric = m_metric;
+	m_domainLinks.clear();
+}
+
+void
+ControlCenter::UpdateDomains()
+{
+	if(!m_domainRouter.IsBuilt() || m_domainRebuild || m_domainMetric != m_metric)
+	{
+		RebuildDomains();
+		return;
+	}
+	for(auto it = m_domainLinks.begin(); it != m_domainLinks.end(); ++it)
+	{
+		int from = it->first;
+		int to = it->second;
+		double cost = from < m_num && to < m_num && m_G[from][to] == 1 ? EdgeCost(from,to)
+				: std::numeric_limits<double>::infinity();
+		if(!m_domainRouter.SetLinkCost(from,to,cost))
 		{
-			cost.push_back(-1);
-			flag.push_back(1);
-			continue;
+			RebuildDomains();
+			return;
 		}
-		cost.push_back(m_edges[{src,*it}].delay.GetSeconds());
-		flag.push_back(1);
 	}
-	table.push_back({path,cost});
-	flag[src] = 0;
+	m_domainLinks.clear();
+	m_domainRouter.Refresh();
+}
 
-	while(*(table.rbegin()->first.rbegin()) != dst )
-	{
-		double min_cost = 9999;
-		int min_ind;
-		std::vector<int> by_path;
+void
+ControlCenter::DomainLinkChanged(int from, int to)
+{
+	//nothing to track before the first build, it reads every link
+	if(m_domainRouter.IsBuilt()) m_domainLinks.insert({from,to});
+}
+
+uint32_t
+ControlCenter::GetBorderCount()
+{
+	UpdateDomains();
+	return m_domainRouter.GetBorderCount();
+}
+
+std::vector<std::vector<int>>
+ControlCenter::CalculateKPaths(int src, int dst, uint32_t k)
+{
+	//Yen's algorithm: every further path deviates from an accepted one
+	//at a spur node, the shared root is kept and the spur edges used by
+	//the accepted paths are removed before searching again
+	std::vector<std::vector<int>> accepted;
+	std::vector<int> first = CalculatePath(src,dst);
+	if(first.empty()) return accepted;
+	accepted.push_back(first);
 
-		for(auto it = table.begin(); it != table.end(); ++it)
+	std::vector<std::pair<double,std::vector<int>>> candidates;
+	while(accepted.size() < k)
+	{
+		const std::vector<int> last = accepted.back();
+		for(uint32_t i = 0; i + 1 < last.size(); ++i)
 		{
-			int ind = 0;
-			for(auto iit = it->second.begin(); iit != it->second.end(); ++iit)
+			int spur = last[i];
+			std::vector<int> root(last.begin(),last.begin()+i+1);
+
+			std::set<std::pair<int,int>> removed_edges;
+			for(auto it = accepted.begin(); it != accepted.end(); ++it)
 			{
-				if(flag[ind] == 0) {ind+=1; continue;}
-				if(*iit >= 0 && *iit < min_cost)
+				if(it->size() > i + 1 && std::equal(root.begin(),root.end(),it->begin()))
 				{
-					min_cost = *iit;
-					min_ind = ind;
-					by_path = it->first;
+					removed_edges.insert({(*it)[i],(*it)[i+1]});
 				}
-				ind+=1;
 			}
-		}
-		by_path.push_back(min_ind);
-		flag[min_ind] = 0;
-		std::vector<double> cost;
-		for(auto it = m_G[min_ind].begin(); it != m_G[min_ind].end(); ++it)
-		{
-			if(*it == 0)
+			std::vector<bool> removed_nodes(m_num,false);
+			for(uint32_t j = 0; j < i; ++j)
 			{
-				cost.push_back(0);
-				continue;
+				removed_nodes[root[j]] = true;
 			}
-			if(*it == -1)
+
+			std::vector<int> spur_path = ShortestPath(spur,dst,removed_nodes,removed_edges);
+			if(spur_path.empty()) continue;
+
+			std::vector<int> total(root.begin(),root.end()-1);
+			total.insert(total.end(),spur_path.begin(),spur_path.end());
+
+			bool known = std::find(accepted.begin(),accepted.end(),total) != accepted.end();
+			for(auto it = candidates.begin(); !known && it != candidates.end(); ++it)
 			{
-				cost.push_back(-1);
-				continue;
+				known = it->second == total;
 			}
-			cost.push_back(m_edges[{src,*it}].delay.GetSeconds()+min_cost);
+			if(!known) candidates.push_back({PathCost(total),total});
 		}
-		table.push_back({by_path,cost});
-	}
+		if(candidates.empty()) break;
 
-	path = table.rbegin()->first;
+		auto best = std::min_element(candidates.begin(),candidates.end());
+		accepted.push_back(best->second);
+		candidates.erase(best);
+	}
+	return accepted;
+}
 
-	return path;
+std::vector<double>
+ControlCenter::CostsTo(int dst)const
+{
+	std::vector<double> to_dst;
+	std::vector<int> prev;
+	Dijkstra(dst,true,std::vector<bool>(m_num,false),std::set<std::pair<int,int>>(),to_dst,prev);
+	return to_dst;
 }
 
-Ipv4Address
-ControlCenter::GetGateWay(int cur, int next)
+std::map<int,std::map<int,double>>
+ControlCenter::BuildNextHopGroups(const std::vector<std::vector<int>>& paths, const std::vector<double>& to_dst)const
 {
-	Ptr<Node> c = INDTONODE.find(cur)->second;
-	Ptr<Node> n = INDTONODE.find(next)->second;
-	Ptr<Ipv4> nip = n->GetObject<Ipv4>();
-	for(uint32_t i = 0; i < c->GetNDevices(); ++i)
+	//Only keep the paths on which every hop gets strictly closer to 'dst',
+	//so the union of next hops is a DAG and per-switch choices cannot loop.
+	//The shortest path is always kept. A path is weighted by the headroom
+	//of its most loaded edge, and each switch splits its traffic in
+	//proportion to the weights of the paths crossing it.
+	std::map<int,std::map<int,double>> groups;
+
+	for(auto it = paths.begin(); it != paths.end(); ++it)
 	{
-		Ptr<NetDevice> md = c->GetDevice(i);
-		Ptr<Channel> mch = md->GetChannel();
-		for(uint32_t j = 0; j< n->GetNDevices(); ++j)
+		bool downhill = true;
+		double max_load = 0;
+		for(uint32_t i = 0; i + 1 < it->size(); ++i)
 		{
-			Ptr<NetDevice> od = n->GetDevice(j);
-			Ptr<Channel> och = od->GetChannel();
+			int cur = (*it)[i];
+			int next = (*it)[i+1];
+			if(!(to_dst[next] < to_dst[cur])) downhill = false;
+			auto edge = m_edges.find({cur,next});
+			if(edge != m_edges.end()) max_load = std::max(max_load,edge->second.load);
+		}
+		if(!downhill && it != paths.begin()) continue;
+
+		double weight = std::max(1 - max_load,0.01);
+		for(uint32_t i = 0; i + 1 < it->size(); ++i)
+		{
+			groups[(*it)[i]][(*it)[i+1]] += weight;
+		}
+	}
+	return groups;
+}
+
+std::map<int,int>
+ControlCenter::BackupNextHops(const std::map<int,std::map<int,double>>& groups, const std::vector<double>& to_dst)const
+{
+	//loop-free alternate per switch: a neighbour outside the primary group that
+	//is strictly closer to 'dst' than the switch itself, so traffic it receives
+	//cannot come back (downstream criterion); the cheapest such neighbour wins
+	std::map<int,int> backups;
 
-			if(mch == och)
+	for(auto it = groups.begin(); it != groups.end(); ++it)
+	{
+		int cur = it->first;
+		double best = std::numeric_limits<double>::infinity();
+		for(int v = 0; v < m_num; ++v)
+		{
+			if(m_G[cur][v] != 1 || it->second.count(v)) continue;
+			if(!(to_dst[v] < to_dst[cur])) continue;
+			double cost = EdgeCost(cur,v) + to_dst[v];
+			if(cost < best)
 			{
-				return nip->GetAddress(nip->GetInterfaceForDevice(od),0).GetAddress();
+				best = cost;
+				backups[cur] = v;
 			}
 		}
 	}
-	return Ipv4Address();
+	return backups;
 }
 
-Ptr<NetDevice>
-ControlCenter::GetOutputDevice(int cur, int next)
+const NeighborPort*
+ControlCenter::FindPort(int cur, int next)
+{
+	if((int)m_ports.size() <= cur || !m_portsBuilt[cur])
+	{
+		BuildPorts(cur);
+	}
+	auto it = m_ports[cur].find(next);
+	if(it == m_ports[cur].end()) return 0;
+	return &it->second;
+}
+
+void
+ControlCenter::BuildPorts(int cur)
 {
-	Ptr<Node> c = INDTONODE.find(cur)->second;
-	Ptr<Node> n = INDTONODE.find(next)->second;
+	if((int)m_ports.size() <= cur)
+	{
+		m_ports.resize(cur + 1);
+		m_portsBuilt.resize(cur + 1,false);
+	}
+	std::unordered_map<int,NeighborPort>& ports = m_ports[cur];
+	ports.clear();
+	m_portsBuilt[cur] = true;
+
+	Ptr<Node> c = RoutingProtocol::REGISTRY.GetNode(cur);
+	Ptr<Ipv4> cip = c->GetObject<Ipv4>();
 	for(uint32_t i = 0; i < c->GetNDevices(); ++i)
 	{
 		Ptr<NetDevice> md = c->GetDevice(i);
 		Ptr<Channel> mch = md->GetChannel();
-		for(uint32_t j = 0; j< n->GetNDevices(); ++j)
+		if(!mch) continue;
+		for(uint32_t j = 0; j < mch->GetNDevices(); ++j)
 		{
-			Ptr<NetDevice> od = n->GetDevice(j);
-			Ptr<Channel> och = od->GetChannel();
+			Ptr<NetDevice> od = mch->GetDevice(j);
+			if(od == md) continue;
+			int o = RoutingProtocol::REGISTRY.GetIndex(od->GetNode());
+			if(o == -1 || ports.count(o)) continue;
 
-			if(mch == och)
+			NeighborPort port;
+			port.dev = md;
+			port.iface = cip ? cip->GetInterfaceForDevice(md) : -1;
+			Ptr<Ipv4> nip = od->GetNode()->GetObject<Ipv4>();
+			int32_t oif = nip ? nip->GetInterfaceForDevice(od) : -1;
+			if(oif >= 0 && nip->GetNAddresses(oif) > 0)
 			{
-				return md;
+				port.gateway = nip->GetAddress(oif,0).GetAddress();
 			}
+			ports[o] = port;
+		}
+	}
+}
+
+void
+ControlCenter::RefreshPorts(int ind)
+{
+	//nothing cached yet, the table is built on first use
+	if((int)m_ports.size() <= ind || !m_portsBuilt[ind]) return;
+
+	//the neighbours hold this node's address as their gateway
+	std::vector<int> neighbors;
+	for(auto it = m_ports[ind].begin(); it != m_ports[ind].end(); ++it)
+	{
+		neighbors.push_back(it->first);
+	}
+	BuildPorts(ind);
+	for(auto it = m_ports[ind].begin(); it != m_ports[ind].end(); ++it)
+	{
+		neighbors.push_back(it->first);
+	}
+	for(auto it = neighbors.begin(); it != neighbors.end(); ++it)
+	{
+		if((int)m_ports.size() > *it && m_portsBuilt[*it])
+		{
+			BuildPorts(*it);
 		}
 	}
-	Ptr<NetDevice> d;
-	return d;
+}
+
+Ipv4Address
+ControlCenter::GetGateWay(int cur, int next)
+{
+	const NeighborPort* port = FindPort(cur,next);
+	return port ? port->gateway : Ipv4Address();
+}
+
+Ptr<NetDevice>
+ControlCenter::GetOutputDevice(int cur, int next)
+{
+	const NeighborPort* port = FindPort(cur,next);
+	return port ? port->dev : Ptr<NetDevice>();
+}
+
+int32_t
+ControlCenter::GetInterface(int cur, int next)
+{
+	const NeighborPort* port = FindPort(cur,next);
+	return port ? port->iface : -1;
 }
 
 
 void
 ControlCenter::ChangeEdge(int from, int to, Edge val)
 {
-  m_edges[{from,to}] = val;
+  Edge& edge = m_edges[{from,to}];
+  if(edge.delay != val.delay)
+    {
+      //patch the latency of every switch whose control path crosses this edge
+      auto it = m_conEdges.find({from,to});
+      if(it != m_conEdges.end())
+        {
+          for(auto swc = it->second.begin(); swc != it->second.end(); ++swc)
+            {
+              m_conDelay[*swc] = m_conDelay[*swc] + val.delay - edge.delay;
+            }
+        }
+    }
+  //paths only move when the cost under the active metric does, a load
+  //change is invisible to DELAY and HOP_COUNT
+  if(EdgeCost(edge) != EdgeCost(val))
+    {
+      ++m_topoVersion;
+      DomainLinkChanged(from,to);
+    }
+  edge = val;
+}
+
+std::vector<std::vector<double>>
+ControlCenter::GetControlDistances()const
+{
+  //dist[s][c]: delay in seconds of the fastest path from 's' to 'c'
+  std::vector<std::vector<double>> dist(m_num,std::vector<double>(m_num));
+  std::vector<double> to_c;
+  std::vector<int> prev;
+  for(int c = 0; c < m_num; ++c)
+    {
+      Dijkstra<DelayMetric>(c,true,std::vector<bool>(m_num,false),std::set<std::pair<int,int>>(),to_c,prev);
+      for(int s = 0; s < m_num; ++s)
+        {
+          dist[s][c] = to_c[s];
+        }
+    }
+  return dist;
+}
+
+bool
+ControlCenter::WriteSnapshot(std::string filename)const
+{
+  SnapshotWriter writer(m_num,Simulator::Now().GetNanoSeconds());
+  for(uint32_t i = 0; i < m_G.size(); ++i)
+    {
+      for(uint32_t j = 0; j < m_G[i].size(); ++j)
+        {
+          writer.SetAdjacency(i,j,m_G[i][j]);
+        }
+    }
+  for(auto it = m_edges.begin(); it != m_edges.end(); ++it)
+    {
+      writer.AddEdge(it->first.first,it->first.second,
+                     it->second.delay.GetNanoSeconds(),it->second.load);
+    }
+  for(auto it = m_swcTocon.begin(); it != m_swcTocon.end(); ++it)
+    {
+      if(it->first < m_num) writer.SetController(it->first,it->second);
+    }
+  for(auto it = m_path.begin(); it != m_path.end(); ++it)
+    {
+      writer.AddPath(it->first.first,it->first.second,it->second);
+    }
+  for(uint32_t swc = 0; swc < m_conPath.size(); ++swc)
+    {
+      const std::vector<int>& path = m_conPath[swc];
+      if(path.size() < 2 || m_path.count({path.front(),path.back()})) continue;
+      writer.AddPath(path.front(),path.back(),path);
+    }
+  return writer.Write(filename);
+}
+
+void
+ControlCenter::ScheduleSnapshot(Time at, std::string filename)
+{
+  Simulator::Schedule(at,&ControlCenter::WriteSnapshotEvent,this,filename);
+}
+
+void
+ControlCenter::WriteSnapshotEvent(std::string filename)
+{
+  WriteSnapshot(filename);
 }
 
 void
@@ -451,6 +1505,36 @@ ControlCenter::SetNum(int num)
   m_num = num;
 }
 
+void
+ControlCenter::SetPathCount(uint32_t k)
+{
+  m_k = std::max(k,1u);
+}
+
+void
+ControlCenter::SetHierarchical(bool hierarchical)
+{
+  m_hierarchical = hierarchical;
+}
+
+void
+ControlCenter::SetInBand(bool inBand)
+{
+  m_inBand = inBand;
+}
+
+bool
+ControlCenter::IsInBand()const
+{
+  return m_inBand;
+}
+
+void
+ControlCenter::SetSourceRouting(bool sourceRouting)
+{
+  m_sourceRouting = sourceRouting;
+}
+
 void
 ControlCenter::InitG()
 {
@@ -473,12 +1557,161 @@ ControlCenter::InitG()
 void
 ControlCenter::ChangeG(int from, int to, int val)
 {
+  if(m_G[from][to] != val)
+    {
+      ++m_topoVersion;
+      DomainLinkChanged(from,to);
+    }
   m_G[from][to] = val;
+  ScheduleTableUpdate();
 }
 void
 ControlCenter::RecvHello(int from, int to ,Edge edge)
+{
+	if(!IsServerModelled())
+	{
+		HandleHello(from,to,edge);
+		return;
+	}
+	Time wait;
+	if(!Admit(m_helloService,wait))
+	{
+		++m_helloDrops;
+		return;
+	}
+	Simulator::Schedule(wait,&ControlCenter::ServeHello,this,from,to,edge,m_computeAdded);
+}
+
+void
+ControlCenter::ServeHello(int from, int to ,Edge edge, Time admitted)
+{
+	Time wait;
+	if(Postpone(admitted,wait))
+	{
+		Simulator::Schedule(wait,&ControlCenter::ServeHello,this,from,to,edge,m_computeAdded);
+		return;
+	}
+	--m_jobs;
+	HandleHello(from,to,edge);
+}
+
+void
+ControlCenter::HandleHello(int from, int to ,Edge edge)
 {
 	ChangeEdge(from,to,edge);
+	ScheduleTableUpdate();
+}
+
+void
+ControlCenter::RecvHelloReport(int from, std::vector<std::pair<int,Edge>> links)
+{
+	if(!IsServerModelled())
+	{
+		HandleHelloReport(from,links);
+		return;
+	}
+	Time wait;
+	if(!Admit(m_helloService,wait))
+	{
+		++m_helloDrops;
+		return;
+	}
+	Simulator::Schedule(wait,&ControlCenter::ServeHelloReport,this,from,links,m_computeAdded);
+}
+
+void
+ControlCenter::ServeHelloReport(int from, std::vector<std::pair<int,Edge>> links, Time admitted)
+{
+	Time wait;
+	if(Postpone(admitted,wait))
+	{
+		Simulator::Schedule(wait,&ControlCenter::ServeHelloReport,this,from,links,m_computeAdded);
+		return;
+	}
+	--m_jobs;
+	HandleHelloReport(from,links);
+}
+
+void
+ControlCenter::HandleHelloReport(int from, const std::vector<std::pair<int,Edge>>& links)
+{
+	for(auto it = links.begin(); it != links.end(); ++it)
+	{
+		ChangeEdge(from,it->first,it->second);
+	}
+	ScheduleTableUpdate();
+}
+
+uint64_t
+ControlCenter::GetRepairs()const
+{
+	return m_repairs;
+}
+
+uint64_t
+ControlCenter::GetReroutes()const
+{
+	return m_reroutes;
+}
+
+uint64_t
+ControlCenter::GetRepairsHeld()const
+{
+	return m_repairsHeld;
+}
+
+uint64_t
+ControlCenter::GetPendingDrops()const
+{
+	return m_pendingDrops;
+}
+
+uint64_t
+ControlCenter::GetTreeComputations()const
+{
+	return m_treeComputations;
+}
+
+uint64_t
+ControlCenter::GetLinkFailures()const
+{
+	return m_linkFailures;
+}
+
+uint64_t
+ControlCenter::GetFlowsRerouted()const
+{
+	return m_flowsRerouted;
+}
+
+const LatencyHistogram&
+ControlCenter::GetReconvergence()const
+{
+	return m_reconvergence;
+}
+
+uint64_t
+ControlCenter::GetRreqDrops()const
+{
+	return m_rreqDrops;
+}
+
+uint64_t
+ControlCenter::GetHelloDrops()const
+{
+	return m_helloDrops;
+}
+
+uint64_t
+ControlCenter::GetRreqUnknown()const
+{
+	return m_rreqUnknown;
+}
+
+Time
+ControlCenter::GetComputeTime()const
+{
+	return m_computeTime;
 }
 
 void
@@ -493,7 +1726,7 @@ ControlCenter::Init(NodeContainer c)
 	//check for one-to-one
 	for(int i = 0; i < m_num; ++i)
 	{
-		if(NODETOIND.find(c.Get(i))->second != i)
+		if(RoutingProtocol::REGISTRY.GetIndex(c.Get(i)) != i)
 		{
 			return;
 		}
@@ -515,13 +1748,25 @@ ControlCenter::Init(NodeContainer c)
 			{
 				o_d = cha->GetDevice(0) == cur_d ? cha->GetDevice(1) : cha->GetDevice(0);
 				o = o_d->GetNode();
-				o_ind = NODETOIND.find(o)->second;
+				o_ind = RoutingProtocol::REGISTRY.GetIndex(o);
 				edge.delay = cha->GetDelay();
 				ChangeG(i,o_ind,1);
 				ChangeEdge(i,o_ind,edge);
 			}
 		}
 	}
+
+	//neighbour ports used when installing routes
+	for(int i = 0; i < m_num; ++i)
+	{
+		BuildPorts(i);
+	}
+
+	if(m_proactive)
+	{
+		m_proactiveEvent.Cancel();
+		m_proactiveEvent = Simulator::ScheduleNow(&ControlCenter::InstallAllTables,this);
+	}
 }
 
 
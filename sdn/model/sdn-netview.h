@@ -5,11 +5,24 @@
 #include "ns3/channel.h"
 #include "ns3/nstime.h"
 #include "sdn-flow-table.h"
+#include "sdn-snapshot.h"
+#include "sdn-domain-router.h"
+#include "sdn-packet.h"
+#include "sdn-stats.h"
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/node.h"
 #include "ns3/simulator.h"
 #include "ns3/sdn.h"
 #include "ns3/node-container.h"
+#include "ns3/object-base.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/event-id.h"
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <chrono>
 
 //extern int NPLANE;
 //extern int NPERPLANE;
@@ -24,10 +37,60 @@ struct Edge
 	Time delay = Seconds(0);
 };
 
-class ControlCenter
+//routing metric policies: the cost of crossing one edge,
+//handed to the path search as a template parameter
+struct DelayMetric
+{
+	static double Cost(const Edge& e){return e.delay.GetSeconds();}
+};
+
+struct HopMetric
+{
+	static double Cost(const Edge&){return 1;}
+};
+
+struct LoadDelayMetric
+{
+	static double Cost(const Edge& e){return e.delay.GetSeconds() * (1 + e.load);}
+};
+
+struct ResidualBandwidthMetric
+{
+	//inverse of the free share of the link, like an OSPF reference bandwidth
+	static double Cost(const Edge& e){return 1 / std::max(1 - e.load, 0.01);}
+};
+
+//how a node reaches one of its direct neighbours
+struct NeighborPort
+{
+	Ptr<NetDevice> dev;		//output device on this node
+	Ipv4Address gateway;		//neighbour's address on the shared link
+	int32_t iface = -1;		//this node's interface index for 'dev'
+};
+
+class ControlCenter : public ObjectBase
 {
 public:
+	enum RoutingMetric
+	{
+		DELAY,
+		HOP_COUNT,
+		LOAD_DELAY,
+		RESIDUAL_BANDWIDTH
+	};
+
+	static TypeId GetTypeId(void);
+	virtual TypeId GetInstanceTypeId(void)const;
+
+	ControlCenter();
+
+	//the control center is a static nothing constructs through the object
+	//factory, this applies the attribute defaults (Config::SetDefault and
+	//the command line) to it
+	void LoadDefaults();
+
 	void SetController(int);
+	void ClearControllers();
 	void AddSwitchToController(int,int);
 	bool IsController(int)const;
 	bool IsExistPath(int,int)const;
@@ -36,6 +99,11 @@ public:
 	void SetNum(int);
 	void InitG();
 	void Init(NodeContainer c);
+	void SetPathCount(uint32_t);
+	void SetHierarchical(bool);
+	void SetInBand(bool);
+	bool IsInBand()const;
+	void SetSourceRouting(bool);
 
 private:
 	std::map<std::pair<int,int>,Edge> m_edges;
@@ -44,19 +112,200 @@ private:
 	std::map<int,int> m_swcTocon;
 
 	int m_num;
+	uint32_t m_k;		//number of paths installed per flow, 1 means single path
+	RoutingMetric m_metric;
 
 	//the nodes exist in the 'm_path' means these
-	//nodes have been known the routes to transmit the flow
+	//nodes have been known the routes to transmit the flow; data flows
+	//only, the control paths are kept in m_conPath
 	std::map<std::pair<int,int>,std::vector<int>> m_path;
+	//flows only: addresses their entries are installed for, the flows
+	//crossing every edge and the edges every flow has entries on, kept by
+	//SetFlowPath and AddFlowEdges
+	std::map<std::pair<int,int>,std::pair<Ipv4Address,Ipv4Address>> m_flowAddresses;
+	std::map<std::pair<int,int>,std::set<std::pair<int,int>>> m_flowEdges;
+	std::map<std::pair<int,int>,std::set<std::pair<int,int>>> m_edgesOfFlow;
+
+	//latency from every switch to its controller, summed once along the
+	//control path and patched in place when a hello moves one of its edges
+	std::vector<Time> m_conDelay;
+	std::vector<bool> m_conDelayValid;
+	std::vector<std::vector<int>> m_conPath;
+	std::map<std::pair<int,int>,std::set<int>> m_conEdges;	//edge -> switches whose control path crosses it
+
+	//RREQs waiting for the batching window to close
+	struct PendingRreq
+	{
+		int req;
+		Ipv4Address src;
+		Ipv4Address dst;
+	};
+	Time m_batchWindow;
+	std::vector<PendingRreq> m_batch;
+	EventId m_batchEvent;
+
+	//shortest-path tree per source, reused for every destination until a
+	//link change or a hello moving an edge cost under m_metric bumps the version
+	struct SptCache
+	{
+		uint64_t version;
+		RoutingMetric metric;
+		std::vector<int> prev;
+	};
+	uint64_t m_topoVersion;
+	std::map<int,SptCache> m_trees;
+	uint64_t m_treeComputations;
+
+	//per node: neighbour index -> port, filled at Init and on interface changes
+	std::vector<std::unordered_map<int,NeighborPort>> m_ports;
+	std::vector<bool> m_portsBuilt;
+
+	//proactive mode: next hop last pushed to every switch per destination node
+	bool m_proactive;
+	Time m_proactiveHold;
+	EventId m_proactiveEvent;
+	uint64_t m_proactiveVersion;
+	std::vector<std::vector<int>> m_pushed;
+	uint64_t m_tableUpdates;		//table messages sent to switches
+	uint64_t m_tableEntries;		//entries carried by them
+
+	//controller as a FIFO server with per-request service times
+	Time m_helloService;
+	Time m_rreqService;
+	Time m_pathService;
+	uint32_t m_queueLimit;
+	bool m_measureCompute;
+	Time m_busyUntil;		//when the last admitted job finishes
+	uint32_t m_jobs;		//admitted jobs not served yet
+	bool m_computing;
+	std::chrono::steady_clock::time_point m_computeStart;
+	Time m_computeTime;		//measured computation time charged so far
+	Time m_computeAdded;		//part of it added while jobs were queued
+	uint64_t m_rreqDrops;
+	uint64_t m_helloDrops;
+	uint64_t m_rreqUnknown;		//RREQs whose source or destination is not registered
+
+	//per-domain path computation: a change of the domains rebuilds it, a
+	//changed link only refreshes the segments of its own domain
+	bool m_hierarchical;
+	DomainRouter m_domainRouter;
+	bool m_domainRebuild;
+	RoutingMetric m_domainMetric;
+	std::set<std::pair<int,int>> m_domainLinks;		//links changed since the last update
+
+	//control messages travel as packets along the control paths instead of
+	//being delivered after the computed control delay
+	bool m_inBand;
+
+	//the ingress switch gets the whole path and stamps it on every packet,
+	//transit switches keep no state for the flow
+	bool m_sourceRouting;
+
+	//RREQs for flows the controller already routed: last answer per
+	//(requesting switch, source, destination), further requests from the
+	//same switch within the hold time are dropped
+	Time m_repairHold;
+	std::map<std::tuple<int,int,int>,Time> m_repaired;
+	std::map<std::pair<int,int>,Time> m_replyDue;		//per flow: the last entry sent for it arrives
+	uint64_t m_pendingDrops;		//requests sent before that, answered by the entries on their way
+	uint64_t m_repairs;		//requests answered by re-sending hops
+	uint64_t m_reroutes;		//repairs that needed a new path
+	uint64_t m_repairsHeld;		//requests dropped by the hold time
+
+	//link failures reported by the switches and the flows moved off them
+	uint64_t m_linkFailures;
+	uint64_t m_flowsRerouted;
+	LatencyHistogram m_reconvergence;
 
 public:
 	Time CalculateDelay(int);
 	void RecvRREQ(int,Ipv4Address,Ipv4Address);
+	void FlushRreqBatch();
+	void InstallAllTables();
+	uint64_t GetTableUpdates()const;
+	uint64_t GetTableEntries()const;
+	std::vector<std::vector<double>> GetControlDistances()const;
+	uint32_t GetBorderCount();
+	bool WriteSnapshot(std::string)const;
+	void ScheduleSnapshot(Time,std::string);
+	uint64_t GetRreqDrops()const;
+	uint64_t GetHelloDrops()const;
+	uint64_t GetRreqUnknown()const;
+	Time GetComputeTime()const;
+	uint64_t GetRepairs()const;
+	uint64_t GetReroutes()const;
+	uint64_t GetRepairsHeld()const;
+	uint64_t GetPendingDrops()const;
+	uint64_t GetTreeComputations()const;		//shortest-path trees built, cached ones excluded
 	std::vector<int> CalculatePath(int,int);
+	std::vector<std::vector<int>> CalculateKPaths(int,int,uint32_t);
 	Ipv4Address GetGateWay(int,int);
 	Ptr<NetDevice> GetOutputDevice(int,int);
+	int32_t GetInterface(int,int);
+	void RefreshPorts(int);
 	void RecvHello(int,int,Edge);
+	void RecvHelloReport(int,std::vector<std::pair<int,Edge>>);
+	void RecvLinkChange(int,int,bool,Time);
+	uint64_t GetLinkFailures()const;
+	uint64_t GetFlowsRerouted()const;
+	const LatencyHistogram& GetReconvergence()const;
+	int GetController(int)const;
+	int GetControlNextHop(int,int,bool);
+
+private:
+	void ProcessRREQ(int,Ipv4Address,Ipv4Address);
+	void RepairFlow(int,Ipv4Address,Ipv4Address,int,int);
+	Time PushHops(int,Ipv4Address,Ipv4Address,const std::vector<int>&,uint32_t);
+	void ExpectReply(int,int,Time);
+	bool IsReplyPending(int,int)const;
+	bool IsPathUp(std::vector<int>::const_iterator,std::vector<int>::const_iterator)const;
+	void SetFlowPath(int,int,const std::vector<int>&);
+	void AddFlowEdges(int,int,const std::vector<int>&);
+	int SourceIndex(int,Ipv4Address)const;
+	std::vector<int> PathFromTree(const std::vector<int>&,int,int)const;
+	const std::vector<int>& SourceTree(int);
+	const NeighborPort* FindPort(int,int);
+	void BuildPorts(int);
+	void ScheduleTableUpdate();
+	void WriteSnapshotEvent(std::string);
+	void RebuildDomains();
+	void UpdateDomains();
+	void DomainLinkChanged(int,int);
+	bool IsServerModelled()const;
+	bool Admit(Time,Time&);
+	bool Postpone(Time,Time&);
+	void ServeRREQ(int,Ipv4Address,Ipv4Address,Time);
+	void HandleRREQ(int,Ipv4Address,Ipv4Address);
+	void ServeHello(int,int,Edge,Time);
+	void HandleHello(int,int,Edge);
+	void ServeHelloReport(int,std::vector<std::pair<int,Edge>>,Time);
+	void HandleHelloReport(int,const std::vector<std::pair<int,Edge>>&);
+	void BeginCompute();
+	void EndCompute();
+	Time ComputeCharge()const;
+	Time ReplyDelay(int);
+	void RefreshControlDelay(int);
+	void SendToSwitch(int,ControlHeader);
+	void InvalidateControlDelay(int);
+
+	template <typename Metric>
+	double EdgeCost(int,int)const;
+	template <typename Metric>
+	double PathCost(const std::vector<int>&)const;
+	template <typename Metric>
+	void Dijkstra(int,bool,const std::vector<bool>&,const std::set<std::pair<int,int>>&,
+			std::vector<double>&,std::vector<int>&)const;
 
+	//select the instantiation matching m_metric
+	double EdgeCost(int,int)const;
+	double EdgeCost(const Edge&)const;
+	double PathCost(const std::vector<int>&)const;
+	void Dijkstra(int,bool,const std::vector<bool>&,const std::set<std::pair<int,int>>&,
+			std::vector<double>&,std::vector<int>&)const;
+	std::vector<int> ShortestPath(int,int,const std::vector<bool>&,const std::set<std::pair<int,int>>&)const;
+	std::vector<double> CostsTo(int)const;		//cost from every node to the given one
+	std::map<int,std::map<int,double>> BuildNextHopGroups(const std::vector<std::vector<int>>&,const std::vector<double>&)const;
+	std::map<int,int> BackupNextHops(const std::map<int,std::map<int,double>>&,const std::vector<double>&)const;
 
 };
 
@@ -0,0 +1,501 @@
+#include "sdn-packet.h"
+#include "ns3/assert.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+namespace sdn {
+
+NS_OBJECT_ENSURE_REGISTERED (ControlHeader);
+NS_OBJECT_ENSURE_REGISTERED (SourceRouteHeader);
+
+static const uint16_t NO_NODE = 0xffff;
+static const uint8_t FLAG_UP = 1;
+
+static void
+WriteNode(Buffer::Iterator& i, int node)
+{
+	i.WriteHtonU16(node < 0 || node >= NO_NODE ? NO_NODE : node);
+}
+
+static int
+ReadNode(Buffer::Iterator& i)
+{
+	uint16_t node = i.ReadNtohU16();
+	return node == NO_NODE ? -1 : node;
+}
+
+static uint16_t
+ToFixed(double val)
+{
+	return std::lround(std::min(std::max(val,0.0),1.0) * 65535);
+}
+
+ControlHeader::ControlHeader(MessageType type)
+	: m_type(type),
+	  m_valid(true),
+	  m_flags(0),
+	  m_origin(-1),
+	  m_target(-1),
+	  m_linkUp(false)
+{
+
+}
+
+TypeId
+ControlHeader::GetTypeId()
+{
+	static TypeId tid = TypeId ("ns3::sdn::ControlHeader")
+		.SetParent<Header> ()
+		.SetGroupName ("SDN")
+		.AddConstructor<ControlHeader> ()
+		;
+	return tid;
+}
+
+TypeId
+ControlHeader::GetInstanceTypeId()const
+{
+	return GetTypeId();
+}
+
+uint32_t
+ControlHeader::GetSerializedSize()const
+{
+	uint32_t size = 6;
+	switch(m_type)
+	{
+	case SDNTYPE_HELLO:
+		return size + 2 + 8 * m_links.size();
+	case SDNTYPE_RREQ:
+		return size + 8;
+	case SDNTYPE_RREP:
+		size += 2;
+		for(auto it = m_flows.begin(); it != m_flows.end(); ++it)
+		{
+			size += 11 + 4 * it->nexts.size();
+		}
+		return size;
+	case SDNTYPE_TABLE:
+		return size + 2 + 6 * m_entries.size();
+	case SDNTYPE_PATH:
+		return size + 10 + 2 * m_path.size();
+	case SDNTYPE_LINK:
+		return size + 11 + 2 * m_neighbors.size();
+	}
+	return size;
+}
+
+void
+ControlHeader::Serialize(Buffer::Iterator i)const
+{
+	i.WriteU8(m_type);
+	i.WriteU8(m_flags);
+	WriteNode(i,m_origin);
+	WriteNode(i,m_target);
+	switch(m_type)
+	{
+	case SDNTYPE_HELLO:
+		i.WriteHtonU16(m_links.size());
+		for(auto it = m_links.begin(); it != m_links.end(); ++it)
+		{
+			WriteNode(i,it->neighbor);
+			i.WriteHtonU32(std::min<int64_t>(std::max<int64_t>(it->delay.GetNanoSeconds(),0),UINT32_MAX));
+			i.WriteHtonU16(ToFixed(it->load));
+		}
+		break;
+	case SDNTYPE_RREQ:
+		i.WriteHtonU32(m_src.Get());
+		i.WriteHtonU32(m_dst.Get());
+		break;
+	case SDNTYPE_RREP:
+		i.WriteHtonU16(m_flows.size());
+		for(auto it = m_flows.begin(); it != m_flows.end(); ++it)
+		{
+			i.WriteHtonU32(it->src.Get());
+			i.WriteHtonU32(it->dst.Get());
+			WriteNode(i,it->backup);
+			i.WriteU8(it->nexts.size());
+			//weights are sums of path weights and may exceed 1, only their
+			//ratios matter: scale the group so that its largest weight is 1
+			double top = 0;
+			for(auto next = it->nexts.begin(); next != it->nexts.end(); ++next)
+			{
+				top = std::max(top,next->second);
+			}
+			for(auto next = it->nexts.begin(); next != it->nexts.end(); ++next)
+			{
+				WriteNode(i,next->first);
+				i.WriteHtonU16(ToFixed(top > 0 ? next->second / top : 0));
+			}
+		}
+		break;
+	case SDNTYPE_TABLE:
+		i.WriteHtonU16(m_entries.size());
+		for(auto it = m_entries.begin(); it != m_entries.end(); ++it)
+		{
+			i.WriteHtonU32(it->dst.Get());
+			WriteNode(i,it->next);
+		}
+		break;
+	case SDNTYPE_PATH:
+		i.WriteHtonU32(m_src.Get());
+		i.WriteHtonU32(m_dst.Get());
+		i.WriteHtonU16(m_path.size());
+		for(auto it = m_path.begin(); it != m_path.end(); ++it)
+		{
+			WriteNode(i,*it);
+		}
+		break;
+	case SDNTYPE_LINK:
+		i.WriteHtonU64(std::max<int64_t>(m_time.GetNanoSeconds(),0));
+		i.WriteU8(m_linkUp);
+		i.WriteHtonU16(m_neighbors.size());
+		for(auto it = m_neighbors.begin(); it != m_neighbors.end(); ++it)
+		{
+			WriteNode(i,*it);
+		}
+		break;
+	}
+}
+
+uint32_t
+ControlHeader::Deserialize(Buffer::Iterator start)
+{
+	Buffer::Iterator i = start;
+	uint8_t type = i.ReadU8();
+	m_valid = type >= SDNTYPE_HELLO && type <= SDNTYPE_LINK;
+	if(!m_valid)
+	{
+		return i.GetDistanceFrom(start);
+	}
+	m_type = (MessageType)type;
+	m_flags = i.ReadU8();
+	m_origin = ReadNode(i);
+	m_target = ReadNode(i);
+	m_links.clear();
+	m_flows.clear();
+	m_entries.clear();
+	m_path.clear();
+	m_neighbors.clear();
+	switch(m_type)
+	{
+	case SDNTYPE_HELLO:
+		m_links.resize(i.ReadNtohU16());
+		for(auto it = m_links.begin(); it != m_links.end(); ++it)
+		{
+			it->neighbor = ReadNode(i);
+			it->delay = NanoSeconds(i.ReadNtohU32());
+			it->load = i.ReadNtohU16() / 65535.0;
+		}
+		break;
+	case SDNTYPE_RREQ:
+		m_src = Ipv4Address(i.ReadNtohU32());
+		m_dst = Ipv4Address(i.ReadNtohU32());
+		break;
+	case SDNTYPE_RREP:
+		m_flows.resize(i.ReadNtohU16());
+		for(auto it = m_flows.begin(); it != m_flows.end(); ++it)
+		{
+			it->src = Ipv4Address(i.ReadNtohU32());
+			it->dst = Ipv4Address(i.ReadNtohU32());
+			it->backup = ReadNode(i);
+			it->nexts.resize(i.ReadU8());
+			for(auto next = it->nexts.begin(); next != it->nexts.end(); ++next)
+			{
+				next->first = ReadNode(i);
+				next->second = i.ReadNtohU16() / 65535.0;
+			}
+		}
+		break;
+	case SDNTYPE_TABLE:
+		m_entries.resize(i.ReadNtohU16());
+		for(auto it = m_entries.begin(); it != m_entries.end(); ++it)
+		{
+			it->dst = Ipv4Address(i.ReadNtohU32());
+			it->next = ReadNode(i);
+		}
+		break;
+	case SDNTYPE_PATH:
+		m_src = Ipv4Address(i.ReadNtohU32());
+		m_dst = Ipv4Address(i.ReadNtohU32());
+		m_path.resize(i.ReadNtohU16());
+		for(auto it = m_path.begin(); it != m_path.end(); ++it)
+		{
+			*it = ReadNode(i);
+		}
+		break;
+	case SDNTYPE_LINK:
+		m_time = NanoSeconds(i.ReadNtohU64());
+		m_linkUp = i.ReadU8();
+		m_neighbors.resize(i.ReadNtohU16());
+		for(auto it = m_neighbors.begin(); it != m_neighbors.end(); ++it)
+		{
+			*it = ReadNode(i);
+		}
+		break;
+	}
+	return i.GetDistanceFrom(start);
+}
+
+void
+ControlHeader::Print(std::ostream &os)const
+{
+	switch(m_type)
+	{
+	case SDNTYPE_HELLO:
+		os << "HELLO links " << m_links.size();
+		break;
+	case SDNTYPE_RREQ:
+		os << "RREQ " << m_src << " -> " << m_dst;
+		break;
+	case SDNTYPE_RREP:
+		os << "RREP flows " << m_flows.size();
+		break;
+	case SDNTYPE_TABLE:
+		os << "TABLE entries " << m_entries.size();
+		break;
+	case SDNTYPE_PATH:
+		os << "PATH " << m_src << " -> " << m_dst << " hops " << m_path.size();
+		break;
+	case SDNTYPE_LINK:
+		os << "LINK " << (m_linkUp ? "up" : "down") << " neighbors " << m_neighbors.size();
+		break;
+	}
+	os << " from " << m_origin << " to " << m_target << (IsUp() ? " up" : " down");
+}
+
+MessageType
+ControlHeader::GetType()const
+{
+	return m_type;
+}
+
+bool
+ControlHeader::IsValid()const
+{
+	return m_valid;
+}
+
+void
+ControlHeader::SetRoute(int origin, int target, bool up)
+{
+	m_origin = origin;
+	m_target = target;
+	m_flags = up ? (m_flags | FLAG_UP) : (m_flags & ~FLAG_UP);
+}
+
+int
+ControlHeader::GetOrigin()const
+{
+	return m_origin;
+}
+
+int
+ControlHeader::GetTarget()const
+{
+	return m_target;
+}
+
+bool
+ControlHeader::IsUp()const
+{
+	return m_flags & FLAG_UP;
+}
+
+int
+ControlHeader::GetSwitch()const
+{
+	return IsUp() ? m_origin : m_target;
+}
+
+void
+ControlHeader::SetLinks(const std::vector<LinkState>& links)
+{
+	m_links = links;
+}
+
+const std::vector<LinkState>&
+ControlHeader::GetLinks()const
+{
+	return m_links;
+}
+
+void
+ControlHeader::SetRequest(Ipv4Address src, Ipv4Address dst)
+{
+	m_src = src;
+	m_dst = dst;
+}
+
+Ipv4Address
+ControlHeader::GetSource()const
+{
+	return m_src;
+}
+
+Ipv4Address
+ControlHeader::GetDestination()const
+{
+	return m_dst;
+}
+
+void
+ControlHeader::SetFlows(const std::vector<FlowEntry>& flows)
+{
+	m_flows = flows;
+}
+
+const std::vector<FlowEntry>&
+ControlHeader::GetFlows()const
+{
+	return m_flows;
+}
+
+void
+ControlHeader::SetEntries(const std::vector<FlowInstall>& entries)
+{
+	m_entries = entries;
+}
+
+const std::vector<FlowInstall>&
+ControlHeader::GetEntries()const
+{
+	return m_entries;
+}
+
+void
+ControlHeader::SetPath(const std::vector<int>& path)
+{
+	m_path = path;
+}
+
+const std::vector<int>&
+ControlHeader::GetPath()const
+{
+	return m_path;
+}
+
+void
+ControlHeader::SetLinkChange(const std::vector<int>& neighbors, bool up, Time at)
+{
+	m_neighbors = neighbors;
+	m_linkUp = up;
+	m_time = at;
+}
+
+const std::vector<int>&
+ControlHeader::GetNeighbors()const
+{
+	return m_neighbors;
+}
+
+bool
+ControlHeader::IsLinkUp()const
+{
+	return m_linkUp;
+}
+
+Time
+ControlHeader::GetTime()const
+{
+	return m_time;
+}
+
+const uint8_t SourceRouteHeader::PROT_NUMBER = 253;
+
+SourceRouteHeader::SourceRouteHeader(uint8_t protocol)
+	: m_protocol(protocol),
+	  m_first(0)
+{
+
+}
+
+TypeId
+SourceRouteHeader::GetTypeId()
+{
+	static TypeId tid = TypeId ("ns3::sdn::SourceRouteHeader")
+		.SetParent<Header> ()
+		.SetGroupName ("SDN")
+		.AddConstructor<SourceRouteHeader> ()
+		;
+	return tid;
+}
+
+TypeId
+SourceRouteHeader::GetInstanceTypeId()const
+{
+	return GetTypeId();
+}
+
+uint32_t
+SourceRouteHeader::GetSerializedSize()const
+{
+	return 2 + 2 * (m_hops.size() - m_first);
+}
+
+void
+SourceRouteHeader::Serialize(Buffer::Iterator i)const
+{
+	i.WriteU8(m_protocol);
+	i.WriteU8(m_hops.size() - m_first);
+	for(uint32_t h = m_first; h < m_hops.size(); ++h)
+	{
+		i.WriteHtonU16(m_hops[h]);
+	}
+}
+
+uint32_t
+SourceRouteHeader::Deserialize(Buffer::Iterator start)
+{
+	Buffer::Iterator i = start;
+	m_protocol = i.ReadU8();
+	m_hops.resize(i.ReadU8());
+	m_first = 0;
+	for(auto it = m_hops.begin(); it != m_hops.end(); ++it)
+	{
+		*it = i.ReadNtohU16();
+	}
+	return i.GetDistanceFrom(start);
+}
+
+void
+SourceRouteHeader::Print(std::ostream &os)const
+{
+	os << "protocol " << (uint32_t)m_protocol << " hops";
+	for(uint32_t h = m_first; h < m_hops.size(); ++h)
+	{
+		os << " " << m_hops[h];
+	}
+}
+
+uint8_t
+SourceRouteHeader::GetProtocol()const
+{
+	return m_protocol;
+}
+
+void
+SourceRouteHeader::SetHops(std::vector<int>::const_iterator begin, std::vector<int>::const_iterator end)
+{
+	NS_ASSERT_MSG (end - begin <= 255, "Source route longer than 255 hops");
+	m_hops.assign(begin,end);
+	m_first = 0;
+}
+
+bool
+SourceRouteHeader::IsEmpty()const
+{
+	return m_first == m_hops.size();
+}
+
+int
+SourceRouteHeader::PopHop()
+{
+	return IsEmpty() ? -1 : m_hops[m_first++];
+}
+
+}
+
+}
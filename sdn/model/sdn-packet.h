@@ -0,0 +1,147 @@
+#ifndef SDN_PACKET_H
+#define SDN_PACKET_H
+
+#include "ns3/header.h"
+#include "ns3/nstime.h"
+#include "ns3/ipv4-address.h"
+#include "sdn-flow-table.h"
+#include <vector>
+
+namespace ns3 {
+
+namespace sdn {
+
+enum MessageType
+{
+	SDNTYPE_HELLO = 1,		//link report, switch -> controller
+	SDNTYPE_RREQ = 2,		//route request, switch -> controller
+	SDNTYPE_RREP = 3,		//flow entries, controller -> switch
+	SDNTYPE_TABLE = 4,		//destination entries, controller -> switch
+	SDNTYPE_PATH = 5,		//source route of a flow, controller -> ingress switch
+	SDNTYPE_LINK = 6		//links gone down or back up, switch -> controller
+};
+
+struct LinkState
+{
+	int neighbor;
+	Time delay;
+	double load;
+};
+
+struct FlowEntry
+{
+	Ipv4Address src;
+	Ipv4Address dst;
+	std::vector<std::pair<int,double>> nexts;		//next hop and weight
+	int backup = -1;
+};
+
+//Control message sent in-band over the SDN_PORT sockets. It travels hop by
+//hop along the control path of one switch: towards its controller when 'up'
+//is set, away from it otherwise; every hop relays it until 'target' is reached.
+//
+//  uint8_t  type
+//  uint8_t  flags                 bit 0: up
+//  uint16_t origin, target        node indices
+//  body, by type:
+//    HELLO  uint16_t count, count * {uint16_t neighbor, uint32_t delay (ns), uint16_t load (1/65535)}
+//    RREQ   uint32_t src, uint32_t dst
+//    RREP   uint16_t count, count * {uint32_t src, uint32_t dst, uint16_t backup,
+//           uint8_t n, n * {uint16_t next, uint16_t weight (1/65535 of the group's largest)}}
+//    TABLE  uint16_t count, count * {uint32_t dst, uint16_t next}
+//    PATH   uint32_t src, uint32_t dst, uint16_t count, count * uint16_t node
+//    LINK   uint64_t time (ns), uint8_t up, uint16_t count, count * uint16_t neighbor
+//
+//Integers are in network byte order, a node index of 0xffff stands for -1.
+class ControlHeader : public Header
+{
+public:
+	ControlHeader(MessageType type = SDNTYPE_HELLO);
+
+	static TypeId GetTypeId();
+	TypeId GetInstanceTypeId()const;
+	uint32_t GetSerializedSize()const;
+	void Serialize(Buffer::Iterator start)const;
+	uint32_t Deserialize(Buffer::Iterator start);
+	void Print(std::ostream &os)const;
+
+	MessageType GetType()const;
+	bool IsValid()const;
+
+	void SetRoute(int origin, int target, bool up);
+	int GetOrigin()const;
+	int GetTarget()const;
+	bool IsUp()const;
+	int GetSwitch()const;		//the switch whose control path is followed
+
+	void SetLinks(const std::vector<LinkState>&);
+	const std::vector<LinkState>& GetLinks()const;
+	void SetRequest(Ipv4Address src, Ipv4Address dst);
+	Ipv4Address GetSource()const;
+	Ipv4Address GetDestination()const;
+	void SetFlows(const std::vector<FlowEntry>&);
+	const std::vector<FlowEntry>& GetFlows()const;
+	void SetEntries(const std::vector<FlowInstall>&);
+	const std::vector<FlowInstall>& GetEntries()const;
+	void SetPath(const std::vector<int>&);		//with SetRequest for the flow
+	const std::vector<int>& GetPath()const;
+	void SetLinkChange(const std::vector<int>& neighbors, bool up, Time at);
+	const std::vector<int>& GetNeighbors()const;
+	bool IsLinkUp()const;
+	Time GetTime()const;		//when the switch noticed the change
+
+private:
+	MessageType m_type;
+	bool m_valid;
+	uint8_t m_flags;
+	int m_origin;
+	int m_target;
+
+	std::vector<LinkState> m_links;
+	Ipv4Address m_src;
+	Ipv4Address m_dst;
+	std::vector<FlowEntry> m_flows;
+	std::vector<FlowInstall> m_entries;
+	std::vector<int> m_path;
+	std::vector<int> m_neighbors;
+	bool m_linkUp;
+	Time m_time;
+};
+
+//Source route of one packet, between its IPv4 header and its transport
+//header. While it is there the IPv4 protocol field is PROT_NUMBER; every
+//transit switch pops the next hop, the destination strips the header.
+//
+//  uint8_t  protocol              the protocol number it replaces
+//  uint8_t  count
+//  uint16_t hops[count]           nodes still to visit after the receiver
+class SourceRouteHeader : public Header
+{
+public:
+	static const uint8_t PROT_NUMBER;		//253, reserved for experimentation (RFC 3692)
+
+	SourceRouteHeader(uint8_t protocol = 0);
+
+	static TypeId GetTypeId();
+	TypeId GetInstanceTypeId()const;
+	uint32_t GetSerializedSize()const;
+	void Serialize(Buffer::Iterator start)const;
+	uint32_t Deserialize(Buffer::Iterator start);
+	void Print(std::ostream &os)const;
+
+	uint8_t GetProtocol()const;
+	void SetHops(std::vector<int>::const_iterator begin, std::vector<int>::const_iterator end);
+	bool IsEmpty()const;
+	int PopHop();
+
+private:
+	uint8_t m_protocol;
+	std::vector<uint16_t> m_hops;
+	uint32_t m_first;		//hops before it are popped
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+#include "sdn-registry.h"
+
+namespace ns3 {
+
+namespace sdn {
+
+NodeRegistry::NodeRegistry()
+	: m_used(0)
+{
+
+}
+
+void
+NodeRegistry::AddNode(Ptr<Node> node, int index)
+{
+	uint32_t id = node->GetId();
+	if(m_idToIndex.size() <= id)
+	{
+		m_idToIndex.resize(id + 1,-1);
+	}
+	m_idToIndex[id] = index;
+	if((int)m_nodes.size() <= index)
+	{
+		m_nodes.resize(index + 1);
+	}
+	m_nodes[index] = node;
+}
+
+uint32_t
+NodeRegistry::Slot(uint32_t key)const
+{
+	//Fibonacci hashing, then linear probing to the key or an empty slot
+	uint32_t mask = m_keys.size() - 1;
+	uint32_t slot = (key * 2654435769u) & mask;
+	while(m_values[slot] != -1 && m_keys[slot] != key)
+	{
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+void
+NodeRegistry::Grow()
+{
+	std::vector<uint32_t> keys;
+	std::vector<int> values;
+	keys.swap(m_keys);
+	values.swap(m_values);
+	uint32_t size = keys.empty() ? 16 : keys.size() * 2;
+	m_keys.assign(size,0);
+	m_values.assign(size,-1);
+	for(uint32_t i = 0; i < keys.size(); ++i)
+	{
+		if(values[i] == -1) continue;
+		uint32_t slot = Slot(keys[i]);
+		m_keys[slot] = keys[i];
+		m_values[slot] = values[i];
+	}
+}
+
+void
+NodeRegistry::AddAddress(Ipv4Address address, int index)
+{
+	//keep the load factor under one half
+	if((m_used + 1) * 2 > m_keys.size())
+	{
+		Grow();
+	}
+	uint32_t key = address.Get();
+	uint32_t slot = Slot(key);
+	if(m_values[slot] == -1)
+	{
+		++m_used;
+		m_addresses.push_back({address,index});
+	}
+	else
+	{
+		for(auto it = m_addresses.begin(); it != m_addresses.end(); ++it)
+		{
+			if(it->first == address) it->second = index;
+		}
+	}
+	m_keys[slot] = key;
+	m_values[slot] = index;
+}
+
+void
+NodeRegistry::Clear()
+{
+	m_idToIndex.clear();
+	m_nodes.clear();
+	m_keys.clear();
+	m_values.clear();
+	m_used = 0;
+	m_addresses.clear();
+}
+
+int
+NodeRegistry::GetIndex(Ptr<Node> node)const
+{
+	if(!node) return -1;
+	uint32_t id = node->GetId();
+	return id < m_idToIndex.size() ? m_idToIndex[id] : -1;
+}
+
+int
+NodeRegistry::GetIndex(Ipv4Address address)const
+{
+	if(m_used == 0) return -1;
+	return m_values[Slot(address.Get())];
+}
+
+Ptr<Node>
+NodeRegistry::GetNode(int index)const
+{
+	if(index < 0 || index >= (int)m_nodes.size()) return Ptr<Node>();
+	return m_nodes[index];
+}
+
+uint32_t
+NodeRegistry::GetN()const
+{
+	return m_nodes.size();
+}
+
+const std::vector<std::pair<Ipv4Address,int>>&
+NodeRegistry::GetAddresses()const
+{
+	return m_addresses;
+}
+
+}
+
+}
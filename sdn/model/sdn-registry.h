@@ -0,0 +1,49 @@
+#ifndef SDN_REGISTRY_H
+#define SDN_REGISTRY_H
+
+#include "ns3/node.h"
+#include "ns3/ipv4-address.h"
+#include <vector>
+
+namespace ns3 {
+
+namespace sdn {
+
+//Maps nodes and their addresses to the dense indices used by the controller.
+//Node lookups are array loads by Node::GetId (), address lookups go through
+//an open-addressing hash table keyed by the 32 bit address.
+class NodeRegistry
+{
+public:
+	NodeRegistry();
+
+	void AddNode(Ptr<Node>,int);
+	void AddAddress(Ipv4Address,int);
+	void Clear();
+
+	int GetIndex(Ptr<Node>)const;		//-1 if unknown
+	int GetIndex(Ipv4Address)const;		//-1 if unknown
+	Ptr<Node> GetNode(int)const;
+	uint32_t GetN()const;
+
+	//every registered (address, index) pair, in registration order
+	const std::vector<std::pair<Ipv4Address,int>>& GetAddresses()const;
+
+private:
+	uint32_t Slot(uint32_t)const;
+	void Grow();
+
+	std::vector<int> m_idToIndex;		//Node::GetId () -> index
+	std::vector<Ptr<Node>> m_nodes;		//index -> node
+
+	std::vector<uint32_t> m_keys;
+	std::vector<int> m_values;		//-1 marks an empty slot
+	uint32_t m_used;
+	std::vector<std::pair<Ipv4Address,int>> m_addresses;
+};
+
+}
+
+}
+
+#endif
@@ -73,6 +73,22 @@ RequestQueue::Dequeue (Ipv4Address src, Ipv4Address dst, QueueEntry & entry)
   return false;
 }
 
+bool
+RequestQueue::Dequeue (Ipv4Address dst, QueueEntry & entry)
+{
+  Purge ();
+  for (std::vector<QueueEntry>::iterator i = m_queue.begin (); i != m_queue.end (); ++i)
+    {
+      if (i->GetIpv4Header ().GetDestination () == dst)
+        {
+          entry = *i;
+          m_queue.erase (i);
+          return true;
+        }
+    }
+  return false;
+}
+
 bool
 RequestQueue::Find (Ipv4Address dst)
 {
@@ -170,6 +170,14 @@ public:
    * \returns true if the entry is dequeued
    */
   bool Dequeue (Ipv4Address src, Ipv4Address dst, QueueEntry & entry);
+  /**
+   * Return the earliest entry for given destination, whatever its source
+   *
+   * \param dst the destination IP address
+   * \param entry the queue entry
+   * \returns true if the entry is dequeued
+   */
+  bool Dequeue (Ipv4Address dst, QueueEntry & entry);
   /**
    * Remove all packets with destination IP address dst
    * \param dst the destination IP address
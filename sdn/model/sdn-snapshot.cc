@@ -0,0 +1,239 @@
+#include "sdn-snapshot.h"
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+namespace sdn {
+
+static uint64_t
+Align8(uint64_t off)
+{
+	return (off + 7) & ~uint64_t(7);
+}
+
+//'count' records of 'size' bytes from 'offset' end within 'limit',
+//written so that corrupt values cannot overflow
+static bool
+SectionFits(uint64_t offset, uint64_t count, uint64_t size, uint64_t limit)
+{
+	return offset % 8 == 0 && offset <= limit && count <= (limit - offset) / size;
+}
+
+SnapshotWriter::SnapshotWriter(uint32_t numNodes, int64_t time)
+	: m_adjacency(uint64_t(numNodes) * numNodes, -1),
+	  m_controller(numNodes, -1)
+{
+	std::memset(&m_header, 0, sizeof(m_header));
+	std::memcpy(m_header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	m_header.version = SNAPSHOT_VERSION;
+	m_header.numNodes = numNodes;
+	m_header.time = time;
+}
+
+void
+SnapshotWriter::SetAdjacency(uint32_t from, uint32_t to, int8_t val)
+{
+	m_adjacency[uint64_t(from) * m_header.numNodes + to] = val;
+}
+
+void
+SnapshotWriter::AddEdge(int32_t from, int32_t to, int64_t delay, double load)
+{
+	SnapshotEdge edge;
+	edge.from = from;
+	edge.to = to;
+	edge.delay = delay;
+	edge.load = load;
+	m_edges.push_back(edge);
+}
+
+void
+SnapshotWriter::SetController(uint32_t swc, int32_t con)
+{
+	m_controller[swc] = con;
+}
+
+void
+SnapshotWriter::AddPath(int32_t src, int32_t dst, const std::vector<int>& nodes)
+{
+	SnapshotPath path;
+	path.src = src;
+	path.dst = dst;
+	path.first = m_pathNodes.size();
+	path.length = nodes.size();
+	path.reserved = 0;
+	m_paths.push_back(path);
+	m_pathNodes.insert(m_pathNodes.end(), nodes.begin(), nodes.end());
+}
+
+bool
+SnapshotWriter::Write(const std::string& filename)const
+{
+	SnapshotHeader header = m_header;
+	uint64_t off = Align8(sizeof(SnapshotHeader));
+	header.adjacencyOffset = off;
+	off = Align8(off + m_adjacency.size());
+	header.edgeOffset = off;
+	header.edgeCount = m_edges.size();
+	off = Align8(off + m_edges.size() * sizeof(SnapshotEdge));
+	header.controllerOffset = off;
+	off = Align8(off + m_controller.size() * sizeof(int32_t));
+	header.pathOffset = off;
+	header.pathCount = m_paths.size();
+	off = Align8(off + m_paths.size() * sizeof(SnapshotPath));
+	header.pathNodeOffset = off;
+	header.pathNodeCount = m_pathNodes.size();
+	off = Align8(off + m_pathNodes.size() * sizeof(int32_t));
+	header.fileSize = off;
+
+	std::vector<char> image(off, 0);
+	std::memcpy(&image[0], &header, sizeof(header));
+	if(!m_adjacency.empty())
+		std::memcpy(&image[header.adjacencyOffset], &m_adjacency[0], m_adjacency.size());
+	if(!m_edges.empty())
+		std::memcpy(&image[header.edgeOffset], &m_edges[0], m_edges.size() * sizeof(SnapshotEdge));
+	if(!m_controller.empty())
+		std::memcpy(&image[header.controllerOffset], &m_controller[0], m_controller.size() * sizeof(int32_t));
+	if(!m_paths.empty())
+		std::memcpy(&image[header.pathOffset], &m_paths[0], m_paths.size() * sizeof(SnapshotPath));
+	if(!m_pathNodes.empty())
+		std::memcpy(&image[header.pathNodeOffset], &m_pathNodes[0], m_pathNodes.size() * sizeof(int32_t));
+
+	FILE* f = std::fopen(filename.c_str(), "wb");
+	if(!f) return false;
+	bool ok = std::fwrite(&image[0], 1, image.size(), f) == image.size();
+	return std::fclose(f) == 0 && ok;
+}
+
+SnapshotView::SnapshotView()
+	: m_data(0),
+	  m_size(0)
+{
+
+}
+
+SnapshotView::~SnapshotView()
+{
+	Close();
+}
+
+bool
+SnapshotView::Open(const std::string& filename)
+{
+	Close();
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if(fd < 0) return false;
+	struct stat st;
+	if(::fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SnapshotHeader))
+	{
+		::close(fd);
+		return false;
+	}
+	void* data = ::mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(data == MAP_FAILED) return false;
+	m_data = static_cast<const char*>(data);
+	m_size = st.st_size;
+
+	if(!IsValid())
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool
+SnapshotView::IsValid()const
+{
+	//every accessor indexes the mapping through the header, so a truncated
+	//or corrupt file is refused here rather than read past its end
+	const SnapshotHeader& header = GetHeader();
+	if(std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+			|| header.version != SNAPSHOT_VERSION || header.fileSize > m_size)
+	{
+		return false;
+	}
+	uint64_t limit = header.fileSize;
+	uint64_t nodes = header.numNodes;
+	if(!SectionFits(header.adjacencyOffset, nodes * nodes, sizeof(int8_t), limit)
+			|| !SectionFits(header.edgeOffset, header.edgeCount, sizeof(SnapshotEdge), limit)
+			|| !SectionFits(header.controllerOffset, nodes, sizeof(int32_t), limit)
+			|| !SectionFits(header.pathOffset, header.pathCount, sizeof(SnapshotPath), limit)
+			|| !SectionFits(header.pathNodeOffset, header.pathNodeCount, sizeof(int32_t), limit))
+	{
+		return false;
+	}
+	const SnapshotPath* paths = reinterpret_cast<const SnapshotPath*>(m_data + header.pathOffset);
+	for(uint64_t i = 0; i < header.pathCount; ++i)
+	{
+		if(paths[i].first > header.pathNodeCount || paths[i].length > header.pathNodeCount - paths[i].first)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+SnapshotView::Close()
+{
+	if(m_data)
+	{
+		::munmap(const_cast<char*>(m_data), m_size);
+	}
+	m_data = 0;
+	m_size = 0;
+}
+
+bool
+SnapshotView::IsOpen()const
+{
+	return m_data != 0;
+}
+
+const SnapshotHeader&
+SnapshotView::GetHeader()const
+{
+	return *reinterpret_cast<const SnapshotHeader*>(m_data);
+}
+
+int8_t
+SnapshotView::GetAdjacency(uint32_t from, uint32_t to)const
+{
+	const int8_t* adj = reinterpret_cast<const int8_t*>(m_data + GetHeader().adjacencyOffset);
+	return adj[uint64_t(from) * GetHeader().numNodes + to];
+}
+
+const SnapshotEdge*
+SnapshotView::GetEdges()const
+{
+	return reinterpret_cast<const SnapshotEdge*>(m_data + GetHeader().edgeOffset);
+}
+
+int32_t
+SnapshotView::GetController(uint32_t swc)const
+{
+	return reinterpret_cast<const int32_t*>(m_data + GetHeader().controllerOffset)[swc];
+}
+
+const SnapshotPath*
+SnapshotView::GetPaths()const
+{
+	return reinterpret_cast<const SnapshotPath*>(m_data + GetHeader().pathOffset);
+}
+
+const int32_t*
+SnapshotView::GetPathNodes(const SnapshotPath& path)const
+{
+	return reinterpret_cast<const int32_t*>(m_data + GetHeader().pathNodeOffset) + path.first;
+}
+
+}
+
+}
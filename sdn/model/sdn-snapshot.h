@@ -0,0 +1,111 @@
+#ifndef SDN_SNAPSHOT_H
+#define SDN_SNAPSHOT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+namespace sdn {
+
+//Binary snapshot of the controller state, laid out so a reader can mmap the
+//file and index the sections directly. Every record has a fixed size, every
+//section starts on an 8 byte boundary and offsets count from the file start.
+//Integers are in host byte order.
+//
+//  SnapshotHeader
+//  int8_t   adjacency[numNodes*numNodes]    m_G, row-major
+//  SnapshotEdge  edges[edgeCount]
+//  int32_t  controller[numNodes]            controller of every switch, -1 if none
+//  SnapshotPath  paths[pathCount]
+//  int32_t  pathNodes[pathNodeCount]        node lists referenced by 'paths'
+
+static const char SNAPSHOT_MAGIC[8] = {'S','D','N','S','N','A','P','\0'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t numNodes;
+	int64_t time;				//simulation time in nanoseconds
+	uint64_t adjacencyOffset;
+	uint64_t edgeOffset;
+	uint64_t edgeCount;
+	uint64_t controllerOffset;
+	uint64_t pathOffset;
+	uint64_t pathCount;
+	uint64_t pathNodeOffset;
+	uint64_t pathNodeCount;
+	uint64_t fileSize;
+};
+
+struct SnapshotEdge
+{
+	int32_t from;
+	int32_t to;
+	int64_t delay;				//nanoseconds
+	double load;
+};
+
+struct SnapshotPath
+{
+	int32_t src;
+	int32_t dst;
+	uint64_t first;				//index of the first node in pathNodes
+	uint32_t length;
+	uint32_t reserved;
+};
+
+//builds the image in memory and writes it with a single call
+class SnapshotWriter
+{
+public:
+	SnapshotWriter(uint32_t numNodes, int64_t time);
+	void SetAdjacency(uint32_t from, uint32_t to, int8_t val);
+	void AddEdge(int32_t from, int32_t to, int64_t delay, double load);
+	void SetController(uint32_t swc, int32_t con);
+	void AddPath(int32_t src, int32_t dst, const std::vector<int>& nodes);
+	bool Write(const std::string& filename)const;
+
+private:
+	SnapshotHeader m_header;
+	std::vector<int8_t> m_adjacency;
+	std::vector<SnapshotEdge> m_edges;
+	std::vector<int32_t> m_controller;
+	std::vector<SnapshotPath> m_paths;
+	std::vector<int32_t> m_pathNodes;
+};
+
+//read-only view of a snapshot file, mapped into memory
+class SnapshotView
+{
+public:
+	SnapshotView();
+	~SnapshotView();
+	bool Open(const std::string& filename);
+	void Close();
+	bool IsOpen()const;
+
+	const SnapshotHeader& GetHeader()const;
+	int8_t GetAdjacency(uint32_t from, uint32_t to)const;
+	const SnapshotEdge* GetEdges()const;
+	int32_t GetController(uint32_t swc)const;
+	const SnapshotPath* GetPaths()const;
+	const int32_t* GetPathNodes(const SnapshotPath& path)const;
+
+private:
+	SnapshotView(const SnapshotView&);
+	SnapshotView& operator=(const SnapshotView&);
+	bool IsValid()const;		//header sections and path ranges lie inside the file
+
+	const char* m_data;
+	uint64_t m_size;
+};
+
+}
+
+}
+
+#endif
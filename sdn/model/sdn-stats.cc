@@ -0,0 +1,194 @@
+#include "sdn-stats.h"
+#include <algorithm>
+#include <limits>
+
+namespace ns3 {
+
+namespace sdn {
+
+static const uint32_t SUB_BITS = 3;
+static const uint32_t SUB_COUNT = 1 << SUB_BITS;
+static const uint32_t BUCKET_COUNT = SUB_COUNT + (64 - SUB_BITS) * SUB_COUNT;
+
+LatencyHistogram::LatencyHistogram()
+	: m_count(0),
+	  m_sum(0),
+	  m_min(std::numeric_limits<int64_t>::max()),
+	  m_max(0)
+{
+
+}
+
+uint32_t
+LatencyHistogram::Bucket(uint64_t ns)
+{
+	//values below SUB_COUNT get a bucket each, larger ones are split by their
+	//highest set bit and the SUB_BITS bits right below it
+	if(ns < SUB_COUNT) return ns;
+	uint32_t exp = 63 - __builtin_clzll(ns);
+	uint32_t sub = (ns >> (exp - SUB_BITS)) & (SUB_COUNT - 1);
+	return SUB_COUNT + (exp - SUB_BITS) * SUB_COUNT + sub;
+}
+
+uint64_t
+LatencyHistogram::Lower(uint32_t bucket)
+{
+	if(bucket < SUB_COUNT) return bucket;
+	uint32_t exp = SUB_BITS + (bucket - SUB_COUNT) / SUB_COUNT;
+	uint64_t sub = (bucket - SUB_COUNT) % SUB_COUNT;
+	return (SUB_COUNT + sub) << (exp - SUB_BITS);
+}
+
+void
+LatencyHistogram::Add(Time t)
+{
+	int64_t ns = std::max<int64_t>(t.GetNanoSeconds(),0);
+	if(m_buckets.empty())
+	{
+		m_buckets.assign(BUCKET_COUNT,0);
+	}
+	++m_buckets[Bucket(ns)];
+	++m_count;
+	m_sum += ns;
+	m_min = std::min(m_min,ns);
+	m_max = std::max(m_max,ns);
+}
+
+void
+LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+	if(other.m_count == 0) return;
+	if(m_buckets.empty())
+	{
+		m_buckets.assign(BUCKET_COUNT,0);
+	}
+	for(uint32_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		m_buckets[i] += other.m_buckets[i];
+	}
+	m_count += other.m_count;
+	m_sum += other.m_sum;
+	m_min = std::min(m_min,other.m_min);
+	m_max = std::max(m_max,other.m_max);
+}
+
+void
+LatencyHistogram::Clear()
+{
+	m_buckets.clear();
+	m_count = 0;
+	m_sum = 0;
+	m_min = std::numeric_limits<int64_t>::max();
+	m_max = 0;
+}
+
+uint64_t
+LatencyHistogram::GetCount()const
+{
+	return m_count;
+}
+
+Time
+LatencyHistogram::GetMin()const
+{
+	return NanoSeconds(m_count ? m_min : 0);
+}
+
+Time
+LatencyHistogram::GetMax()const
+{
+	return NanoSeconds(m_max);
+}
+
+Time
+LatencyHistogram::GetMean()const
+{
+	return NanoSeconds(m_count ? m_sum / m_count : 0);
+}
+
+Time
+LatencyHistogram::GetQuantile(double q)const
+{
+	if(m_count == 0) return Seconds(0);
+	uint64_t rank = std::max<uint64_t>(1,std::min<double>(q,1) * m_count + 0.5);
+	uint64_t seen = 0;
+	for(uint32_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		seen += m_buckets[i];
+		if(seen >= rank)
+		{
+			uint64_t upper = i + 1 < BUCKET_COUNT ? Lower(i + 1) - 1 : m_max;
+			return NanoSeconds(std::min<int64_t>(upper,m_max));
+		}
+	}
+	return NanoSeconds(m_max);
+}
+
+uint32_t
+LatencyHistogram::GetNBuckets()const
+{
+	return BUCKET_COUNT;
+}
+
+uint64_t
+LatencyHistogram::GetBucketCount(uint32_t bucket)const
+{
+	return bucket < m_buckets.size() ? m_buckets[bucket] : 0;
+}
+
+Time
+LatencyHistogram::GetBucketLower(uint32_t bucket)const
+{
+	return NanoSeconds(Lower(bucket));
+}
+
+void
+LatencyHistogram::Print(std::ostream& os)const
+{
+	os << "n=" << m_count;
+	if(m_count == 0) return;
+	os << " min=" << GetMin().GetSeconds() << "s"
+	   << " mean=" << GetMean().GetSeconds() << "s"
+	   << " p50=" << GetQuantile(0.5).GetSeconds() << "s"
+	   << " p99=" << GetQuantile(0.99).GetSeconds() << "s"
+	   << " max=" << GetMax().GetSeconds() << "s";
+}
+
+void
+FlowSetupStats::Merge(const FlowSetupStats& other)
+{
+	hits += other.hits;
+	misses += other.misses;
+	rreqs += other.rreqs;
+	setup.Merge(other.setup);
+}
+
+void
+FlowSetupStats::Print(std::ostream& os)const
+{
+	os << "hits " << hits << " misses " << misses << " rreqs " << rreqs << " setup ";
+	setup.Print(os);
+}
+
+void
+SprayStats::Merge(const SprayStats& other)
+{
+	packets += other.packets;
+	bytes += other.bytes;
+	switches += other.switches;
+	flowlets += other.flowlets;
+	delivered += other.delivered;
+	deliveredBytes += other.deliveredBytes;
+	reordered += other.reordered;
+}
+
+void
+SprayStats::Print(std::ostream& os)const
+{
+	os << "packets " << packets << " bytes " << bytes << " switches " << switches
+	   << " flowlets " << flowlets << " delivered " << delivered << " delivered-bytes " << deliveredBytes << " reordered " << reordered;
+}
+
+}
+
+}
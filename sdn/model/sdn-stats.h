@@ -0,0 +1,79 @@
+#ifndef SDN_STATS_H
+#define SDN_STATS_H
+
+#include "ns3/nstime.h"
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+
+namespace ns3 {
+
+namespace sdn {
+
+//Histogram of latencies with logarithmic buckets: eight buckets per power of
+//two of nanoseconds, so every bucket is at most 12.5% wide. Adding a sample
+//is a few shifts and an increment; the buckets are allocated on first use.
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void Add(Time);
+	void Merge(const LatencyHistogram&);
+	void Clear();
+
+	uint64_t GetCount()const;
+	Time GetMin()const;
+	Time GetMax()const;
+	Time GetMean()const;
+	Time GetQuantile(double)const;		//upper edge of the bucket holding the quantile
+
+	uint32_t GetNBuckets()const;
+	uint64_t GetBucketCount(uint32_t)const;
+	Time GetBucketLower(uint32_t)const;
+
+	void Print(std::ostream&)const;
+
+	static uint32_t Bucket(uint64_t ns);
+	static uint64_t Lower(uint32_t bucket);
+
+private:
+	std::vector<uint64_t> m_buckets;
+	uint64_t m_count;
+	double m_sum;		//nanoseconds
+	int64_t m_min;
+	int64_t m_max;
+};
+
+//Flow setup counters of one switch, or of all of them
+struct FlowSetupStats
+{
+	uint64_t hits = 0;		//flow table lookups that found an entry
+	uint64_t misses = 0;		//lookups that did not
+	uint64_t rreqs = 0;		//route requests sent to the controller
+	LatencyHistogram setup;		//miss in RouteOutput -> packet released from the queue
+
+	void Merge(const FlowSetupStats&);
+	void Print(std::ostream&)const;
+};
+
+//Multipath counters of one switch under one spraying mode
+struct SprayStats
+{
+	uint64_t packets = 0;		//packets sent through the flow table
+	uint64_t bytes = 0;
+	uint64_t switches = 0;		//packets sent on another member than their flow's previous one
+	uint64_t flowlets = 0;		//flowlets started
+	uint64_t delivered = 0;		//packets delivered locally
+	uint64_t deliveredBytes = 0;
+	uint64_t reordered = 0;		//delivered after a packet of their flow created later
+
+	void Merge(const SprayStats&);
+	void Print(std::ostream&)const;
+};
+
+}
+
+}
+
+#endif
@@ -1,10 +1,11 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
 #include "sdn.h"
+#include "ns3/hash.h"
+#include "ns3/double.h"
+#include <algorithm>
+#include <cmath>
 
-std::map<ns3::Ptr<ns3::Node>,int> NODETOIND;
-std::map<int,ns3::Ptr<ns3::Node>> INDTONODE;
-std::map<ns3::Ipv4Address,int> ADDTOIND;
 
 namespace ns3 {
 
@@ -24,8 +25,9 @@ public:
    * \brief Constructor
    * \param o the output interface
    */
-  DeferredRouteOutputTag (int32_t o = -1) : Tag (),
-                                            m_oif (o)
+  DeferredRouteOutputTag (int32_t o = -1, Time t = Seconds (0)) : Tag (),
+                                                                   m_oif (o),
+                                                                   m_time (t.GetInteger ())
   {
   }
 
@@ -66,39 +68,110 @@ public:
     m_oif = oif;
   }
 
+  /**
+   * \brief Get the time of the flow table miss
+   * \return the time the packet was deferred
+   */
+  Time GetTime () const
+  {
+    return Time (m_time);
+  }
+
   uint32_t GetSerializedSize () const
   {
-    return sizeof(int32_t);
+    return sizeof(int32_t) + sizeof(int64_t);
   }
 
   void  Serialize (TagBuffer i) const
   {
     i.WriteU32 (m_oif);
+    i.WriteU64 (m_time);
   }
 
   void  Deserialize (TagBuffer i)
   {
     m_oif = i.ReadU32 ();
+    m_time = i.ReadU64 ();
   }
 
   void  Print (std::ostream &os) const
   {
-    os << "DeferredRouteOutputTag: output interface = " << m_oif;
+    os << "DeferredRouteOutputTag: output interface = " << m_oif << " deferred at " << GetTime ();
   }
 
 private:
   /// Positive if output device is fixed in RouteOutput
   int32_t m_oif;
+  /// Time of the flow table miss, in time steps
+  int64_t m_time;
 };
 
 NS_OBJECT_ENSURE_REGISTERED (DeferredRouteOutputTag);
 
+/// Marks an in-band control packet with the interface towards the next hop
+class ControlPacketTag : public Tag
+{
+
+public:
+  ControlPacketTag (int32_t o = -1) : Tag (),
+                                      m_oif (o)
+  {
+  }
+
+  static TypeId GetTypeId ()
+  {
+    static TypeId tid = TypeId ("ns3::sdn::ControlPacketTag")
+      .SetParent<Tag> ()
+      .SetGroupName ("SDN")
+      .AddConstructor<ControlPacketTag> ()
+    ;
+    return tid;
+  }
+
+  TypeId  GetInstanceTypeId () const
+  {
+    return GetTypeId ();
+  }
+
+  int32_t GetInterface () const
+  {
+    return m_oif;
+  }
+
+  uint32_t GetSerializedSize () const
+  {
+    return sizeof(int32_t);
+  }
+
+  void  Serialize (TagBuffer i) const
+  {
+    i.WriteU32 (m_oif);
+  }
+
+  void  Deserialize (TagBuffer i)
+  {
+    m_oif = i.ReadU32 ();
+  }
+
+  void  Print (std::ostream &os) const
+  {
+    os << "ControlPacketTag: output interface = " << m_oif;
+  }
+
+private:
+  int32_t m_oif;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ControlPacketTag);
+
 
 
 const uint32_t RoutingProtocol::SDN_PORT = 321;
 
 ControlCenter RoutingProtocol::NETCENTER = ControlCenter();
 
+NodeRegistry RoutingProtocol::REGISTRY = NodeRegistry();
+
 //FlowTable RoutingProtocol::GLOBAL_FLOWTABLE = FlowTable();
 //
 //FlowTable RoutingProtocol::LOCAL_FLOWTABLE = FlowTable();
@@ -112,10 +185,88 @@ RoutingProtocol::GetTypeId(void)
       .SetParent<Ipv4RoutingProtocol>()
       .SetGroupName ("SDN")
       .AddConstructor<RoutingProtocol>()
+      .AddAttribute ("HelloInterval", "Period at which link state is sampled.",
+                     TimeValue (Seconds (0.5)),
+                     MakeTimeAccessor (&RoutingProtocol::m_interval),
+                     MakeTimeChecker ())
+      .AddAttribute ("TriggeredUpdates", "Report a link only when it changed beyond the thresholds "
+                     "or stayed silent for MaxSilence, instead of every interval.",
+                     BooleanValue (false),
+                     MakeBooleanAccessor (&RoutingProtocol::m_triggered),
+                     MakeBooleanChecker ())
+      .AddAttribute ("DelayThreshold", "Absolute delay change that triggers a report, zero disables it.",
+                     TimeValue (Seconds (0)),
+                     MakeTimeAccessor (&RoutingProtocol::m_delayThreshold),
+                     MakeTimeChecker ())
+      .AddAttribute ("LoadThreshold", "Absolute load change that triggers a report, zero disables it.",
+                     DoubleValue (0.05),
+                     MakeDoubleAccessor (&RoutingProtocol::m_loadThreshold),
+                     MakeDoubleChecker<double> (0))
+      .AddAttribute ("RelativeThreshold", "Delay or load change, relative to the last report, "
+                     "that triggers a report, zero disables it.",
+                     DoubleValue (0.1),
+                     MakeDoubleAccessor (&RoutingProtocol::m_relThreshold),
+                     MakeDoubleChecker<double> (0))
+      .AddAttribute ("MaxSilence", "Longest time a link goes unreported in triggered mode.",
+                     TimeValue (Seconds (5)),
+                     MakeTimeAccessor (&RoutingProtocol::m_maxSilence),
+                     MakeTimeChecker ())
+      .AddAttribute ("SprayMode", "How packets of a flow are spread over the members of its next-hop group.",
+                     EnumValue (PathSprayer::FLOW_HASH),
+                     MakeEnumAccessor (&RoutingProtocol::SetSprayMode,
+                                       &RoutingProtocol::GetSprayMode),
+                     MakeEnumChecker (PathSprayer::FLOW_HASH, "FlowHash",
+                                      PathSprayer::ROUND_ROBIN, "RoundRobin",
+                                      PathSprayer::FLOWLET, "Flowlet"))
+      .AddAttribute ("FlowletGap", "Idle time after which a flow may move to another member in Flowlet mode.",
+                     TimeValue (MicroSeconds (500)),
+                     MakeTimeAccessor (&RoutingProtocol::SetFlowletGap,
+                                       &RoutingProtocol::GetFlowletGap),
+                     MakeTimeChecker ())
+      .AddTraceSource ("TableMiss", "A locally originated packet found no flow table entry.",
+                       MakeTraceSourceAccessor (&RoutingProtocol::m_tableMissTrace),
+                       "ns3::sdn::RoutingProtocol::TableMissTracedCallback")
+      .AddTraceSource ("Rreq", "A route request was sent to the controller.",
+                       MakeTraceSourceAccessor (&RoutingProtocol::m_rreqTrace),
+                       "ns3::sdn::RoutingProtocol::RreqTracedCallback")
+      .AddTraceSource ("FlowSetup", "A deferred packet was released, with the time it waited.",
+                       MakeTraceSourceAccessor (&RoutingProtocol::m_flowSetupTrace),
+                       "ns3::sdn::RoutingProtocol::FlowSetupTracedCallback")
       ;
   return tid;
 }
 
+static bool
+Exceeds (double now, double last, double abs, double rel)
+{
+  double diff = std::fabs (now - last);
+  if (abs <= 0 && rel <= 0)
+    {
+      return diff > 0;
+    }
+  return (abs > 0 && diff > abs) || (rel > 0 && diff > rel * std::fabs (last));
+}
+
+bool
+RoutingProtocol::IsReportDue (int neighbor, Time delay, double load)
+{
+  auto it = m_reported.find (neighbor);
+  if (it == m_reported.end ()
+      || Simulator::Now () - it->second.at >= m_maxSilence
+      || Exceeds (delay.GetSeconds (), it->second.delay.GetSeconds (),
+                  m_delayThreshold.GetSeconds (), m_relThreshold)
+      || Exceeds (load, it->second.load, m_loadThreshold, m_relThreshold))
+    {
+      LinkReport report;
+      report.at = Simulator::Now ();
+      report.delay = delay;
+      report.load = load;
+      m_reported[neighbor] = report;
+      return true;
+    }
+  return false;
+}
+
 Ptr<Ipv4Route>
 RoutingProtocol::RouteOutput (Ptr<Packet> p, const Ipv4Header &header,
                               Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
@@ -136,6 +287,13 @@ RoutingProtocol::RouteOutput (Ptr<Packet> p, const Ipv4Header &header,
 
   sockerr = Socket::ERROR_NOTERROR;
 
+  // in-band control messages only ever cross one link
+  ControlPacketTag ctag;
+  if (p->RemovePacketTag (ctag))
+    {
+      return NeighborRoute (header, ctag.GetInterface ());
+    }
+
   Ipv4Address dst = header.GetDestination();
   Ipv4Address src = header.GetSource();
 
@@ -144,20 +302,47 @@ RoutingProtocol::RouteOutput (Ptr<Packet> p, const Ipv4Header &header,
 	  src = GetDefaultSourceAddress();
   }
 
+  ApplyPendingInstalls();
+  if(IsSourceRouted(src, dst))
+  {
+	  //the transport header is only there once the packet comes back
+	  //through the loopback, the source route is stamped in RouteInput
+	  ++m_stats.hits;
+	  DeferredRouteOutputTag tag (-1, Simulator::Now ());
+	  if (!p->PeekPacketTag (tag))
+	    {
+	      p->AddPacketTag (tag);
+	    }
+	  return LoopbackRoute(header, oif);
+  }
   if(m_flowtable.IsExist(src, dst))
   {
-	  return m_flowtable.Get(src,dst);
+	  ++m_stats.hits;
+	  return SelectRoute(src,dst,FlowHash(p,header,false),p->GetSize());
   }
   else
   {
+	  ++m_stats.misses;
+	  ++m_stats.rreqs;
+	  m_tableMissTrace(header);
+	  m_rreqTrace(src,dst);
 	  //Send RREQ
 //	  int src_ind = ADDTOIND.find(src)->second;
 //	  int dst_ind = ADDTOIND.find(dst)->second;
-	  int this_ind = NODETOIND.find(this->GetObject<Node>())->second;
-	  Time time = NETCENTER.CalculateDelay(this_ind);
-	  Simulator::Schedule(time, &ControlCenter::RecvRREQ,&NETCENTER,this_ind,src,dst);
+	  int this_ind = GetIndex();
+	  if(NETCENTER.IsInBand())
+	  {
+		  ControlHeader rreq(SDNTYPE_RREQ);
+		  rreq.SetRequest(src,dst);
+		  Simulator::ScheduleNow(&RoutingProtocol::SendToController,this,rreq);
+	  }
+	  else
+	  {
+		  Time time = NETCENTER.CalculateDelay(this_ind);
+		  Simulator::Schedule(time, &ControlCenter::RecvRREQ,&NETCENTER,this_ind,src,dst);
+	  }
 	  uint32_t iif = (oif ? m_ipv4->GetInterfaceForDevice (oif) : -1);
-	  DeferredRouteOutputTag tag (iif);
+	  DeferredRouteOutputTag tag (iif, Simulator::Now ());
 	  NS_LOG_DEBUG ("Can not find flow-table-item match the transmission-flow.");
 	  if (!p->PeekPacketTag (tag))
 	    {
@@ -190,6 +375,10 @@ RoutingProtocol::RouteInput (Ptr<const Packet> p, const Ipv4Header &header,
       DeferredRouteOutputTag tag;
       if (p->PeekPacketTag (tag))
         {
+          if (IsSourceRouted (header.GetSource (), header.GetDestination ()))
+            {
+              return SendSourceRouted (p, header, ucb);
+            }
           DeferredRouteOutput (p, header, ucb, ecb);
           return true;
         }
@@ -202,10 +391,27 @@ RoutingProtocol::RouteInput (Ptr<const Packet> p, const Ipv4Header &header,
 
   if (m_ipv4->IsDestinationAddress (dst, iif))
     {
+      Ptr<const Packet> packet = p;
+      Ipv4Header inner = header;
+      if (header.GetProtocol () == SourceRouteHeader::PROT_NUMBER)
+        {
+          // strip the source route and hand the transport its own protocol number back
+          Ptr<Packet> copy = p->Copy ();
+          SourceRouteHeader route;
+          copy->RemoveHeader (route);
+          inner.SetProtocol (route.GetProtocol ());
+          inner.SetPayloadSize (copy->GetSize ());
+          packet = copy;
+        }
+      // reordering is measured on the data flows only
+      if (!IsControlPacket (packet, inner))
+        {
+          m_sprayer.Deliver (FlowHash (packet, inner, true), packet->GetUid (), packet->GetSize (), Simulator::Now ());
+        }
       if (lcb.IsNull () == false)
         {
           NS_LOG_LOGIC ("Unicast local delivery to " << dst);
-          lcb (p, header, iif);
+          lcb (packet, inner, iif);
         }
       else
         {
@@ -226,11 +432,28 @@ RoutingProtocol::RouteInput (Ptr<const Packet> p, const Ipv4Header &header,
   return Forwarding (p, header, ucb, ecb);
 }
 
+void
+RoutingProtocol::RefreshNeighborPorts ()
+{
+  // keep the controller's port table in step with this node's interfaces
+  int ind = GetIndex ();
+  if (ind != -1)
+    {
+      NETCENTER.RefreshPorts (ind);
+    }
+}
+
 void
 RoutingProtocol::NotifyInterfaceUp (uint32_t i)
 {
   NS_LOG_FUNCTION (this << m_ipv4->GetAddress (i, 0).GetLocal ());
+  RefreshNeighborPorts ();
   Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
+  if (!m_flowtable.IsDeviceUp (l3->GetNetDevice (i)))
+    {
+      ReportLinkChange (l3->GetNetDevice (i), true);
+    }
+  m_flowtable.SetDeviceUp (l3->GetNetDevice (i), true);
   if (l3->GetNAddresses (i) > 1)
     {
       NS_LOG_WARN ("SDSN does not work with more then one address per each interface.");
@@ -250,23 +473,30 @@ RoutingProtocol::NotifyInterfaceUp (uint32_t i)
   socket->Bind (InetSocketAddress (iface.GetLocal (), SDN_PORT));
   socket->SetAllowBroadcast (false);
   socket->SetIpRecvTtl (true);
-  m_socketAddresses.insert (std::make_pair (socket, iface));
+  AddSocket (socket, iface);
 }
 
 void
 RoutingProtocol::NotifyInterfaceDown (uint32_t i)
 {
   NS_LOG_FUNCTION (this << m_ipv4->GetAddress (i, 0).GetLocal ());
+  RefreshNeighborPorts ();
 
   // Disable layer 2 link state monitoring (if possible)
   Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
   Ptr<NetDevice> dev = l3->GetNetDevice (i);
 
+  // entries leaving through this device lose it, the controller reroutes them
+  m_flowtable.SetDeviceUp (dev, false);
+  uint32_t purged = m_flowtable.PurgeDevice (dev);
+  NS_LOG_LOGIC ("Purged " << purged << " flow table entries on interface " << i);
+  ReportLinkChange (dev, false);
+
   // Close socket
   Ptr<Socket> socket = FindSocketWithInterfaceAddress (m_ipv4->GetAddress (i, 0));
   NS_ASSERT (socket);
   socket->Close ();
-  m_socketAddresses.erase (socket);
+  RemoveSocket (socket);
 
   if (m_socketAddresses.empty ())
     {
@@ -281,6 +511,7 @@ void
 RoutingProtocol::NotifyAddAddress (uint32_t i, Ipv4InterfaceAddress address)
 {
   NS_LOG_FUNCTION (this << " interface " << i << " address " << address);
+  RefreshNeighborPorts ();
   Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
   if (!l3->IsUp (i))
     {
@@ -304,7 +535,7 @@ RoutingProtocol::NotifyAddAddress (uint32_t i, Ipv4InterfaceAddress address)
           socket->BindToNetDevice (l3->GetNetDevice (i));
           socket->Bind (InetSocketAddress (iface.GetLocal (), SDN_PORT));
           socket->SetAllowBroadcast (true);
-          m_socketAddresses.insert (std::make_pair (socket, iface));
+          AddSocket (socket, iface);
         }
     }
   else
@@ -317,12 +548,13 @@ void
 RoutingProtocol::NotifyRemoveAddress (uint32_t i, Ipv4InterfaceAddress address)
 {
   NS_LOG_FUNCTION (this);
+  RefreshNeighborPorts ();
   Ptr<Socket> socket = FindSocketWithInterfaceAddress (address);
   if (socket)
     {
       //m_routingtable.DeleteAllRoutesFromInterface (address);
       socket->Close ();
-      m_socketAddresses.erase (socket);
+      RemoveSocket (socket);
 
       Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
       if (l3->GetNAddresses (i))
@@ -338,7 +570,7 @@ RoutingProtocol::NotifyRemoveAddress (uint32_t i, Ipv4InterfaceAddress address)
           socket->Bind (InetSocketAddress (iface.GetLocal (), SDN_PORT));
           socket->SetAllowBroadcast (false);
           socket->SetIpRecvTtl (true);
-          m_socketAddresses.insert (std::make_pair (socket, iface));
+          AddSocket (socket, iface);
         }
       if (m_socketAddresses.empty ())
         {
@@ -360,6 +592,7 @@ RoutingProtocol::SetIpv4 (Ptr<Ipv4> ipv4)
   NS_ASSERT (m_ipv4 == 0);
 
   m_ipv4 = ipv4;
+  m_index = REGISTRY.GetIndex (m_ipv4->GetObject<Node> ());
 
   // Create lo route. It is asserted that the only one interface up for now is loopback
   NS_ASSERT (m_ipv4->GetNInterfaces () == 1 && m_ipv4->GetAddress (0, 0).GetLocal () == Ipv4Address ("127.0.0.1"));
@@ -387,7 +620,16 @@ RoutingProtocol::RoutingProtocol()
     m_queue (100, Seconds(30)),
 	m_htimer(Timer::CANCEL_ON_DESTROY),
     m_interval (Seconds(0.5)),
-    m_seqNo (0)
+    m_seqNo (0),
+    m_index (-1),
+    m_controlPackets (0),
+    m_controlBytes (0),
+    m_linkReports (0),
+    m_triggered (false),
+    m_delayThreshold (Seconds (0)),
+    m_loadThreshold (0.05),
+    m_relThreshold (0.1),
+    m_maxSilence (Seconds (5))
 {
   m_htimer.SetFunction(&RoutingProtocol::HelloTimerExpire, this);
   uint32_t startTime = rand()%100;
@@ -410,34 +652,245 @@ RoutingProtocol::RecvControlPacket (Ptr<Socket> socket)
       receiver = m_socketAddresses[socket].GetLocal ();
     }
 
-  NS_LOG_DEBUG ("SDSN node " << this << " received a SDSN packet from " << sender << " to " << receiver);
+  NS_LOG_DEBUG ("SDN node " << this << " received a SDN packet from " << sender << " to " << receiver);
 
-//  TypeHeader tHeader (SDNTYPE_RREQ);
-//  packet->RemoveHeader (tHeader);
-//  if (!tHeader.IsValid ())
-//    {
-//      NS_LOG_DEBUG ("SDN message " << packet->GetUid () << " with unknown type received: " << tHeader.Get () << ". Drop");
-//      return; // drop
-//    }
-//  switch (tHeader.Get ())
-//    {
-//    case SDNTYPE_RREQ:
-//      {
-////        RecvRequest (packet, receiver, sender);
-//        break;
-//      }
-//    case SDNTYPE_RREP:
-//      {
-////        RecvReply (packet, receiver, sender);
-//        break;
-//      }
-//    case SDNTYPE_HELLO:
-//      {
-////        RecvHello (packet, receiver, sender);
-//        break;
-//      }
-//    case SDNTYPE_CONFIG:;
-//    }
+  ControlHeader header;
+  packet->RemoveHeader (header);
+  if (!header.IsValid ())
+    {
+      NS_LOG_DEBUG ("SDN message " << packet->GetUid () << " with unknown type received. Drop");
+      return; // drop
+    }
+  SendControl (header);
+}
+
+void
+RoutingProtocol::SendControl (ControlHeader header)
+{
+  NS_LOG_FUNCTION (this << header);
+  int this_ind = GetIndex ();
+  if (header.GetTarget () == this_ind)
+    {
+      RecvControl (header);
+      return;
+    }
+
+  // relay one hop along the control path
+  int next = NETCENTER.GetControlNextHop (this_ind, header.GetSwitch (), header.IsUp ());
+  int32_t iface = next == -1 ? -1 : NETCENTER.GetInterface (this_ind, next);
+  Ptr<Socket> socket;
+  if (iface >= 0)
+    {
+      socket = FindSocketWithInterfaceAddress (m_ipv4->GetAddress (iface, 0));
+    }
+  if (!socket)
+    {
+      NS_LOG_DEBUG ("No control path from " << this_ind << " for " << header << ". Drop");
+      return;
+    }
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  packet->AddPacketTag (ControlPacketTag (iface));
+  ++m_controlPackets;
+  m_controlBytes += packet->GetSize ();
+  SendTo (socket, packet, NETCENTER.GetGateWay (this_ind, next));
+}
+
+void
+RoutingProtocol::SendToController (ControlHeader header)
+{
+  int this_ind = GetIndex ();
+  int con = NETCENTER.GetController (this_ind);
+  if (con == -1)
+    {
+      NS_LOG_DEBUG ("Node " << this_ind << " has no controller. Drop " << header);
+      return;
+    }
+  header.SetRoute (this_ind, con, true);
+  SendControl (header);
+}
+
+void
+RoutingProtocol::RecvControl (const ControlHeader & header)
+{
+  switch (header.GetType ())
+    {
+    case SDNTYPE_HELLO:
+      {
+        std::vector<std::pair<int,Edge> > links;
+        const std::vector<LinkState> & states = header.GetLinks ();
+        for (auto it = states.begin (); it != states.end (); ++it)
+          {
+            Edge edge;
+            edge.delay = it->delay;
+            edge.load = it->load;
+            links.push_back (std::make_pair (it->neighbor, edge));
+          }
+        NETCENTER.RecvHelloReport (header.GetOrigin (), links);
+        break;
+      }
+    case SDNTYPE_RREQ:
+      {
+        NETCENTER.RecvRREQ (header.GetOrigin (), header.GetSource (), header.GetDestination ());
+        break;
+      }
+    case SDNTYPE_RREP:
+      {
+        const std::vector<FlowEntry> & flows = header.GetFlows ();
+        for (auto it = flows.begin (); it != flows.end (); ++it)
+          {
+            InstallGroup (it->src, it->dst, it->nexts, it->backup);
+          }
+        for (auto it = flows.begin (); it != flows.end (); ++it)
+          {
+            SendPacketFromQueue (it->src, it->dst);
+          }
+        break;
+      }
+    case SDNTYPE_TABLE:
+      {
+        RecvTable (header.GetEntries ());
+        break;
+      }
+    case SDNTYPE_PATH:
+      {
+        RecvSourceRoute (header.GetSource (), header.GetDestination (), header.GetPath ());
+        break;
+      }
+    case SDNTYPE_LINK:
+      {
+        const std::vector<int> & neighbors = header.GetNeighbors ();
+        for (auto it = neighbors.begin (); it != neighbors.end (); ++it)
+          {
+            NETCENTER.RecvLinkChange (header.GetOrigin (), *it, header.IsLinkUp (), header.GetTime ());
+          }
+        break;
+      }
+    }
+}
+
+void
+RoutingProtocol::ReportLinkChange (Ptr<NetDevice> dev, bool up)
+{
+  // the neighbour is whoever sits at the other end of the channel
+  int this_ind = GetIndex ();
+  Ptr<Channel> channel = dev ? dev->GetChannel () : Ptr<Channel> ();
+  if (this_ind == -1 || !channel || channel->GetNDevices () != 2)
+    {
+      return;
+    }
+  Ptr<NetDevice> other = channel->GetDevice (0) == dev ? channel->GetDevice (1) : channel->GetDevice (0);
+  int neighbor = REGISTRY.GetIndex (other->GetNode ());
+  if (neighbor == -1)
+    {
+      return;
+    }
+  if (NETCENTER.IsInBand ())
+    {
+      ControlHeader link (SDNTYPE_LINK);
+      link.SetLinkChange (std::vector<int> (1, neighbor), up, Simulator::Now ());
+      Simulator::ScheduleNow (&RoutingProtocol::SendToController, this, link);
+      return;
+    }
+  Simulator::Schedule (NETCENTER.CalculateDelay (this_ind), &ControlCenter::RecvLinkChange,
+                       &NETCENTER, this_ind, neighbor, up, Simulator::Now ());
+}
+
+Ptr<Ipv4Route>
+RoutingProtocol::NeighborRoute (const Ipv4Header & header, int32_t iface) const
+{
+  Ptr<Ipv4Route> rt = Create<Ipv4Route> ();
+  rt->SetDestination (header.GetDestination ());
+  rt->SetGateway (header.GetDestination ());
+  rt->SetSource (m_ipv4->GetAddress (iface, 0).GetLocal ());
+  rt->SetOutputDevice (m_ipv4->GetNetDevice (iface));
+  return rt;
+}
+
+const FlowSetupStats &
+RoutingProtocol::GetStats () const
+{
+  return m_stats;
+}
+
+FlowSetupStats
+RoutingProtocol::GetGlobalStats ()
+{
+  FlowSetupStats stats;
+  for (uint32_t i = 0; i < REGISTRY.GetN (); ++i)
+    {
+      Ptr<Node> node = REGISTRY.GetNode (i);
+      Ptr<RoutingProtocol> rp = node ? node->GetObject<RoutingProtocol> () : Ptr<RoutingProtocol> ();
+      if (rp)
+        {
+          stats.Merge (rp->GetStats ());
+        }
+    }
+  return stats;
+}
+
+void
+RoutingProtocol::SetSprayMode (PathSprayer::Mode mode)
+{
+  m_sprayer.SetMode (mode);
+}
+
+PathSprayer::Mode
+RoutingProtocol::GetSprayMode () const
+{
+  return m_sprayer.GetMode ();
+}
+
+void
+RoutingProtocol::SetFlowletGap (Time gap)
+{
+  m_sprayer.SetFlowletGap (gap);
+}
+
+Time
+RoutingProtocol::GetFlowletGap () const
+{
+  return m_sprayer.GetFlowletGap ();
+}
+
+const SprayStats &
+RoutingProtocol::GetSprayStats (PathSprayer::Mode mode) const
+{
+  return m_sprayer.GetStats (mode);
+}
+
+SprayStats
+RoutingProtocol::GetGlobalSprayStats (PathSprayer::Mode mode)
+{
+  SprayStats stats;
+  for (uint32_t i = 0; i < REGISTRY.GetN (); ++i)
+    {
+      Ptr<Node> node = REGISTRY.GetNode (i);
+      Ptr<RoutingProtocol> rp = node ? node->GetObject<RoutingProtocol> () : Ptr<RoutingProtocol> ();
+      if (rp)
+        {
+          stats.Merge (rp->GetSprayStats (mode));
+        }
+    }
+  return stats;
+}
+
+uint64_t
+RoutingProtocol::GetControlPackets () const
+{
+  return m_controlPackets;
+}
+
+uint64_t
+RoutingProtocol::GetControlBytes () const
+{
+  return m_controlBytes;
+}
+
+uint64_t
+RoutingProtocol::GetLinkReports () const
+{
+  return m_linkReports;
 }
 
 void
@@ -447,6 +900,17 @@ RoutingProtocol::HelloTimerExpire ()
   m_htimer.Cancel();
   m_htimer.Schedule(std::max (Time (Seconds (0)), m_interval));
 }
+int
+RoutingProtocol::GetIndex ()
+{
+  // nodes registered after SetIpv4 are picked up on first use
+  if (m_index == -1)
+    {
+      m_index = REGISTRY.GetIndex (GetObject<Node> ());
+    }
+  return m_index;
+}
+
 Ipv4Address
 RoutingProtocol::GetDefaultSourceAddress()
 {
@@ -458,31 +922,42 @@ RoutingProtocol::LoopbackRoute (const Ipv4Header & hdr, Ptr<NetDevice> oif) cons
 {
   NS_LOG_FUNCTION (this << hdr);
   NS_ASSERT (m_lo != 0);
+  Ipv4Address source = m_defaultLoopbackSource;
+  if (oif)
+    {
+      std::map<Ptr<NetDevice>, Ipv4Address>::const_iterator it = m_loopbackSources.find (oif);
+      source = it == m_loopbackSources.end () ? Ipv4Address () : it->second;
+    }
+  NS_ASSERT_MSG (source.IsInitialized (), "Valid SDSN source address not found");
+  // callers may keep the route, every one gets its own
   Ptr<Ipv4Route> rt = Create<Ipv4Route> ();
+  rt->SetSource (source);
   rt->SetDestination (hdr.GetDestination ());
-  std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin ();
-  if (oif)
+  rt->SetGateway (Ipv4Address::GetLoopback ());
+  rt->SetOutputDevice (m_lo);
+  return rt;
+}
+
+void
+RoutingProtocol::BuildLoopbackRoutes ()
+{
+  m_loopbackSources.clear ();
+  m_defaultLoopbackSource = Ipv4Address ();
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
+         m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
     {
-      // Iterate to find an address on the oif device
-      for (j = m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
+      Ipv4Address addr = j->second.GetLocal ();
+      int32_t interface = m_ipv4->GetInterfaceForAddress (addr);
+      if (!m_defaultLoopbackSource.IsInitialized ())
         {
-          Ipv4Address addr = j->second.GetLocal ();
-          int32_t interface = m_ipv4->GetInterfaceForAddress (addr);
-          if (oif == m_ipv4->GetNetDevice (static_cast<uint32_t> (interface)))
-            {
-              rt->SetSource (addr);
-              break;
-            }
+          m_defaultLoopbackSource = addr;
+        }
+      if (interface >= 0)
+        {
+          // the first address found on a device wins, as the scan did before
+          m_loopbackSources.insert (std::make_pair (m_ipv4->GetNetDevice (static_cast<uint32_t> (interface)), addr));
         }
     }
-  else
-    {
-      rt->SetSource (j->second.GetLocal ());
-    }
-  NS_ASSERT_MSG (rt->GetSource () != Ipv4Address (), "Valid SDSN source address not found");
-  rt->SetGateway (Ipv4Address ("127.0.0.1"));
-  rt->SetOutputDevice (m_lo);
-  return rt;
 }
 
 void
@@ -531,16 +1006,7 @@ bool
 RoutingProtocol::IsMyOwnAddress (Ipv4Address src)
 {
   NS_LOG_FUNCTION (this << src);
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
-         m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
-    {
-      Ipv4InterfaceAddress iface = j->second;
-      if (src == iface.GetLocal ())
-        {
-          return true;
-        }
-    }
-  return false;
+  return std::binary_search (m_localAddresses.begin (), m_localAddresses.end (), src);
 }
 
 bool
@@ -551,11 +1017,19 @@ RoutingProtocol::Forwarding (Ptr<const Packet> p, const Ipv4Header & header,
   Ipv4Address dst = header.GetDestination ();
   Ipv4Address src = header.GetSource ();
 
+  if(header.GetProtocol() == SourceRouteHeader::PROT_NUMBER)
+  {
+	  return ForwardSourceRouted(p, header, ucb);
+  }
+
+  ApplyPendingInstalls();
   if(m_flowtable.IsExist(src, dst))
   {
-	  ucb(m_flowtable.Get(src, dst),p,header);
+	  ++m_stats.hits;
+	  ucb(SelectRoute(src,dst,FlowHash(p,header,true),p->GetSize()),p,header);
 	  return true;
   }
+  ++m_stats.misses;
 
 //  Ipv4Route toDst;
 
@@ -666,24 +1140,101 @@ RoutingProtocol::Forwarding (Ptr<const Packet> p, const Ipv4Header & header,
 //  socket->SendTo (packet, 0, InetSocketAddress (toOrigin.GetDestination(), SDN_PORT));
 //}
 
+uint32_t
+RoutingProtocol::FlowHash (Ptr<const Packet> p, const Ipv4Header & header, bool ports) const
+{
+  // Packets handed to RouteOutput do not carry their transport header yet,
+  // so the ports are only mixed in on transit switches.
+  uint8_t buf[13];
+  header.GetSource ().Serialize (buf);
+  header.GetDestination ().Serialize (buf + 4);
+  buf[8] = header.GetProtocol ();
+  uint32_t len = 9;
+  if (ports && (header.GetProtocol () == 6 || header.GetProtocol () == 17)
+      && p->GetSize () >= 4)
+    {
+      p->CopyData (buf + 9, 4);
+      len = 13;
+    }
+  return Hash32 ((const char *) buf, len);
+}
+
+bool
+RoutingProtocol::IsControlPacket (Ptr<const Packet> p, const Ipv4Header & header) const
+{
+  // in-band control messages are UDP datagrams to SDN_PORT
+  ControlPacketTag ctag;
+  if (p->PeekPacketTag (ctag))
+    {
+      return true;
+    }
+  uint8_t ports[4];
+  if (header.GetProtocol () != 17 || p->GetSize () < 4)
+    {
+      return false;
+    }
+  p->CopyData (ports, 4);
+  return (uint32_t) (ports[2] << 8 | ports[3]) == SDN_PORT;
+}
+
+Ptr<Ipv4Route>
+RoutingProtocol::SelectRoute (Ipv4Address src, Ipv4Address dst, uint32_t flow, uint32_t bytes)
+{
+  return m_sprayer.Select (m_flowtable, src, dst, flow, bytes, Simulator::Now ());
+}
+
 Ptr<Socket>
 RoutingProtocol::FindSocketWithInterfaceAddress (Ipv4InterfaceAddress addr ) const
 {
   NS_LOG_FUNCTION (this << addr);
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
-         m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
+  std::unordered_map<Ipv4Address, Ptr<Socket>, Ipv4AddressHash>::const_iterator it =
+    m_addressSockets.find (addr.GetLocal ());
+  if (it != m_addressSockets.end () && m_socketAddresses.find (it->second)->second == addr)
     {
-      Ptr<Socket> socket = j->first;
-      Ipv4InterfaceAddress iface = j->second;
-      if (iface == addr)
-        {
-          return socket;
-        }
+      return it->second;
     }
   Ptr<Socket> socket;
   return socket;
 }
 
+void
+RoutingProtocol::AddSocket (Ptr<Socket> socket, Ipv4InterfaceAddress iface)
+{
+  m_socketAddresses.insert (std::make_pair (socket, iface));
+  m_addressSockets[iface.GetLocal ()] = socket;
+  std::vector<Ipv4Address>::iterator pos =
+    std::lower_bound (m_localAddresses.begin (), m_localAddresses.end (), iface.GetLocal ());
+  if (pos == m_localAddresses.end () || *pos != iface.GetLocal ())
+    {
+      m_localAddresses.insert (pos, iface.GetLocal ());
+    }
+  BuildLoopbackRoutes ();
+}
+
+void
+RoutingProtocol::RemoveSocket (Ptr<Socket> socket)
+{
+  std::map<Ptr<Socket>, Ipv4InterfaceAddress>::iterator it = m_socketAddresses.find (socket);
+  if (it == m_socketAddresses.end ())
+    {
+      return;
+    }
+  Ipv4Address local = it->second.GetLocal ();
+  m_socketAddresses.erase (it);
+  std::unordered_map<Ipv4Address, Ptr<Socket>, Ipv4AddressHash>::iterator byAddr = m_addressSockets.find (local);
+  if (byAddr != m_addressSockets.end () && byAddr->second == socket)
+    {
+      m_addressSockets.erase (byAddr);
+      std::vector<Ipv4Address>::iterator pos =
+        std::lower_bound (m_localAddresses.begin (), m_localAddresses.end (), local);
+      if (pos != m_localAddresses.end () && *pos == local)
+        {
+          m_localAddresses.erase (pos);
+        }
+    }
+  BuildLoopbackRoutes ();
+}
+
 //void
 //RoutingProtocol::RecvReply (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sender)
 //{
@@ -735,52 +1286,260 @@ RoutingProtocol::FindSocketWithInterfaceAddress (Ipv4InterfaceAddress addr ) con
 //}
 
 void
-RoutingProtocol::SendPacketFromQueue (Ipv4Address src, Ipv4Address dst, Ptr<Ipv4Route> route)
+RoutingProtocol::SendPacketFromQueue (Ipv4Address src, Ipv4Address dst)
 {
   NS_LOG_FUNCTION (this);
+  if (!IsSourceRouted (src, dst) && !m_flowtable.IsExist (src, dst))
+    {
+      // the install was dropped, the packets wait for the rerouted entries
+      return;
+    }
   QueueEntry queueEntry;
   while (m_queue.Dequeue (src, dst, queueEntry))
     {
-      DeferredRouteOutputTag tag;
-      Ptr<Packet> p = ConstCast<Packet> (queueEntry.GetPacket ());
-      if (p->RemovePacketTag (tag)
-          && tag.GetInterface () != -1
-          && tag.GetInterface () != m_ipv4->GetInterfaceForDevice (route->GetOutputDevice ()))
+      if (!SendQueueEntry (queueEntry))
         {
-          NS_LOG_DEBUG ("Output device doesn't match. Dropped.");
           return;
         }
-      UnicastForwardCallback ucb = queueEntry.GetUnicastForwardCallback ();
-      Ipv4Header header = queueEntry.GetIpv4Header ();
-      header.SetSource (route->GetSource ());
-      header.SetTtl (header.GetTtl () + 1); // compensate extra TTL decrement by fake loopback routing
-      ucb (route, p, header);
     }
 }
 
+bool
+RoutingProtocol::SendQueueEntry (QueueEntry & queueEntry)
+{
+  DeferredRouteOutputTag tag;
+  Ptr<Packet> p = ConstCast<Packet> (queueEntry.GetPacket ());
+  Ipv4Header header = queueEntry.GetIpv4Header ();
+  if (IsSourceRouted (header.GetSource (), header.GetDestination ()))
+    {
+      if (p->PeekPacketTag (tag))
+        {
+          RecordFlowSetup (header, tag.GetTime ());
+        }
+      return SendSourceRouted (p, header, queueEntry.GetUnicastForwardCallback ());
+    }
+  Ptr<Ipv4Route> route = SelectRoute (header.GetSource (), header.GetDestination (),
+                                      FlowHash (p, header, false), p->GetSize ());
+  bool deferred = p->RemovePacketTag (tag);
+  if (deferred
+      && tag.GetInterface () != -1
+      && tag.GetInterface () != m_ipv4->GetInterfaceForDevice (route->GetOutputDevice ()))
+    {
+      NS_LOG_DEBUG ("Output device doesn't match. Dropped.");
+      return false;
+    }
+  if (deferred)
+    {
+      RecordFlowSetup (header, tag.GetTime ());
+    }
+  UnicastForwardCallback ucb = queueEntry.GetUnicastForwardCallback ();
+  header.SetSource (route->GetSource ());
+  header.SetTtl (header.GetTtl () + 1); // compensate extra TTL decrement by fake loopback routing
+  ucb (route, p, header);
+  return true;
+}
+
+void
+RoutingProtocol::RecordFlowSetup (const Ipv4Header & header, Time deferredAt)
+{
+  Time latency = Simulator::Now () - deferredAt;
+  m_stats.setup.Add (latency);
+  m_flowSetupTrace (header, latency);
+}
+
+bool
+RoutingProtocol::IsSourceRouted (Ipv4Address src, Ipv4Address dst) const
+{
+  return !m_sourceRoutes.empty () && m_sourceRoutes.count (std::make_pair (src, dst));
+}
+
+bool
+RoutingProtocol::SendSourceRouted (Ptr<const Packet> p, Ipv4Header header, UnicastForwardCallback ucb)
+{
+  const std::vector<int> & path = m_sourceRoutes.find (std::make_pair (header.GetSource (), header.GetDestination ()))->second;
+  Ptr<Ipv4Route> route = MakeRoute (header.GetSource (), header.GetDestination (), path[1]);
+  if (!route->GetOutputDevice ())
+    {
+      NS_LOG_DEBUG ("First hop " << path[1] << " of the source route is not a neighbour. Dropped.");
+      return false;
+    }
+  // the first hop is the one the packet is sent to, the header holds the rest
+  Ptr<Packet> packet = p->Copy ();
+  DeferredRouteOutputTag tag;
+  packet->RemovePacketTag (tag);
+  SourceRouteHeader sr (header.GetProtocol ());
+  sr.SetHops (path.begin () + 2, path.end ());
+  packet->AddHeader (sr);
+  header.SetProtocol (SourceRouteHeader::PROT_NUMBER);
+  header.SetPayloadSize (packet->GetSize ());
+  header.SetTtl (header.GetTtl () + 1); // compensate extra TTL decrement by fake loopback routing
+  ucb (route, packet, header);
+  return true;
+}
+
+bool
+RoutingProtocol::ForwardSourceRouted (Ptr<const Packet> p, Ipv4Header header, UnicastForwardCallback ucb)
+{
+  Ptr<Packet> packet = p->Copy ();
+  SourceRouteHeader sr;
+  packet->RemoveHeader (sr);
+  int next = sr.PopHop ();
+  Ptr<Ipv4Route> route = next == -1 ? Ptr<Ipv4Route> () : MakeRoute (header.GetSource (), header.GetDestination (), next);
+  if (!route || !route->GetOutputDevice ())
+    {
+      NS_LOG_DEBUG ("Drop source-routed packet " << p->GetUid () << ", next hop " << next << " is not reachable.");
+      return false;
+    }
+  packet->AddHeader (sr);
+  header.SetPayloadSize (packet->GetSize ());
+  ucb (route, packet, header);
+  return true;
+}
+
 void
-RoutingProtocol::RecvRREP(Ipv4Address src, Ipv4Address dst, int next)
+RoutingProtocol::RecvSourceRoute(Ipv4Address src, Ipv4Address dst, std::vector<int> path)
+{
+	if(path.size() < 2) return;
+	m_sourceRoutes[std::make_pair(src,dst)] = path;
+	SendPacketFromQueue(src,dst);
+}
+
+Ptr<Ipv4Route>
+RoutingProtocol::MakeRoute(Ipv4Address src, Ipv4Address dst, int next)
 {
-	int this_no = NODETOIND.find(this->GetObject<Node>())->second;
+	int this_no = GetIndex();
 	Ptr<Ipv4Route> route = Create<Ipv4Route>();
 	route->SetSource(src);
 	route->SetDestination(dst);
 	route->SetGateway(NETCENTER.GetGateWay(this_no,next));
 	route->SetOutputDevice(NETCENTER.GetOutputDevice(this_no,next));
+	return route;
+}
+
+void
+RoutingProtocol::RecvRREPBatch(std::vector<FlowInstall> installs)
+{
+	for(auto it = installs.begin(); it != installs.end(); ++it)
+	{
+		InstallGroup(it->src,it->dst,std::vector<std::pair<int,double>>(1,std::make_pair(it->next,1.0)),it->backup);
+	}
+	for(auto it = installs.begin(); it != installs.end(); ++it)
+	{
+		SendPacketFromQueue(it->src,it->dst);
+	}
+}
+
+void
+RoutingProtocol::RecvTable(std::vector<FlowInstall> entries)
+{
+	int this_no = GetIndex();
+	for(auto it = entries.begin(); it != entries.end(); ++it)
+	{
+		if(it->next == -1)
+		{
+			m_flowtable.DeleteDestination(it->dst);
+			continue;
+		}
+		//locally originated packets leave with the address of the output interface
+		Ptr<Ipv4Route> route = Create<Ipv4Route>();
+		int32_t iface = NETCENTER.GetInterface(this_no,it->next);
+		route->SetSource(iface >= 0 ? m_ipv4->GetAddress(iface,0).GetLocal() : GetDefaultSourceAddress());
+		route->SetDestination(it->dst);
+		route->SetGateway(NETCENTER.GetGateWay(this_no,it->next));
+		route->SetOutputDevice(NETCENTER.GetOutputDevice(this_no,it->next));
+		m_flowtable.AddDestination(it->dst,route);
+	}
+
+	QueueEntry queueEntry;
+	for(auto it = entries.begin(); it != entries.end(); ++it)
+	{
+		if(it->next == -1) continue;
+		while(m_queue.Dequeue(it->dst,queueEntry))
+		{
+			if(!SendQueueEntry(queueEntry)) break;
+		}
+	}
+}
+
+bool
+RoutingProtocol::InstallGroup(Ipv4Address src, Ipv4Address dst, const std::vector<std::pair<int,double>>& nexts, int backup)
+{
+	//the entries were computed before the reply arrived, next hops whose
+	//device went down meanwhile are left out like PurgeDevice does
+	NextHopGroup group;
+	for(auto it = nexts.begin(); it != nexts.end(); ++it)
+	{
+		Ptr<Ipv4Route> route = MakeRoute(src,dst,it->first);
+		if(m_flowtable.IsUsable(route))
+		{
+			group.Add(route,it->second);
+		}
+	}
+	Ptr<Ipv4Route> alternate = backup != -1 ? MakeRoute(src,dst,backup) : Ptr<Ipv4Route>();
+	if(alternate && !m_flowtable.IsUsable(alternate))
+	{
+		alternate = 0;
+	}
+	if(group.GetN() == 0 && alternate)
+	{
+		group.Add(alternate,1.0);
+		alternate = 0;
+	}
 	m_flowtable.Delete(src,dst);
-	m_flowtable.Add(src,dst,route);
-	SendPacketFromQueue(src,dst,route);
+	if(group.GetN() == 0)
+	{
+		NS_LOG_LOGIC("No usable next hop for " << src << " -> " << dst << ", install dropped");
+		return false;
+	}
+	m_flowtable.Add(src,dst,group);
+	if(alternate)
+	{
+		m_flowtable.SetBackup(src,dst,alternate);
+	}
+	return true;
+}
+
+void
+RoutingProtocol::QueueInstall(Time at, Ipv4Address src, Ipv4Address dst, const std::vector<std::pair<int,double>>& nexts, int backup)
+{
+	PendingInstall install;
+	install.src = src;
+	install.dst = dst;
+	install.nexts = nexts;
+	install.backup = backup;
+	m_installs.insert(std::make_pair(at,install));
+}
+
+void
+RoutingProtocol::ApplyPendingInstalls()
+{
+	//entries are applied in arrival order when the table is next consulted
+	Time now = Simulator::Now();
+	while(!m_installs.empty() && m_installs.begin()->first <= now)
+	{
+		const PendingInstall& install = m_installs.begin()->second;
+		InstallGroup(install.src,install.dst,install.nexts,install.backup);
+		m_installs.erase(m_installs.begin());
+	}
+}
+
+void
+RoutingProtocol::ReleaseFlow(Ipv4Address src, Ipv4Address dst)
+{
+	ApplyPendingInstalls();
+	SendPacketFromQueue(src,dst);
 }
 
 void
 RoutingProtocol::SendHello()
 {
 	Ptr<Node> this_n = this->GetObject<Node>();
-	int this_ind = NODETOIND.find(this_n)->second;
+	int this_ind = GetIndex();
 	Time delay;
 	double load;
 	Edge edge;
-	Time time = NETCENTER.CalculateDelay(this_ind);
+	//every link of this node goes to the controller in one report
+	std::vector<std::pair<int,Edge>> links;
 	for(uint32_t i = 0; i < this_n->GetNDevices(); ++i)
 	{
 		Ptr<NetDevice> this_d = this_n->GetDevice(i);
@@ -788,19 +1547,37 @@ RoutingProtocol::SendHello()
 		if(this_c)
 		{
 			Ptr<NetDevice> o_d = this_c->GetDevice(0) == this_d ? this_c->GetDevice(1) : this_c->GetDevice(0);
-			int o_ind = NODETOIND.find(o_d->GetNode())->second;
+			int o_ind = REGISTRY.GetIndex(o_d->GetNode());
 			delay = this_c->GetDelay();
 			load = this_d->GetLoad();
-			if(this_ind == 0 && o_ind == 2)
-			{
-				std::cout<<Simulator::Now().GetSeconds()<<": "<<"from "<<this_ind <<" to "<<o_ind<<" delay: "<< delay.GetSeconds()
-						<< " load: "<<load<<std::endl;
-			}
+			NS_LOG_LOGIC ("hello from " << this_ind << " to " << o_ind << " delay: " << delay.GetSeconds ()
+			              << " load: " << load);
 			edge.delay = delay;
 			edge.load = load;
-			Simulator::Schedule(time, &ControlCenter::RecvHello,&NETCENTER,this_ind,o_ind,edge);
+			if(m_triggered && !IsReportDue(o_ind,delay,load)) continue;
+			links.push_back(std::make_pair(o_ind,edge));
 		}
 	}
+	if(links.empty()) return;
+	m_linkReports += links.size();
+	if(NETCENTER.IsInBand())
+	{
+		std::vector<LinkState> states;
+		for(auto it = links.begin(); it != links.end(); ++it)
+		{
+			LinkState state;
+			state.neighbor = it->first;
+			state.delay = it->second.delay;
+			state.load = it->second.load;
+			states.push_back(state);
+		}
+		ControlHeader hello(SDNTYPE_HELLO);
+		hello.SetLinks(states);
+		SendToController(hello);
+		return;
+	}
+	Time time = NETCENTER.CalculateDelay(this_ind);
+	Simulator::Schedule(time, &ControlCenter::RecvHelloReport,&NETCENTER,this_ind,links);
 }
 
 //void
@@ -9,7 +9,12 @@
 #include "ns3/ipv4-l3-protocol.h"
 #include "ns3/udp-socket-factory.h"
 #include "sdn-netview.h"
+#include "sdn-registry.h"
+#include "sdn-packet.h"
+#include "sdn-stats.h"
+#include "ns3/traced-callback.h"
 #include "ns3/node.h"
+#include <unordered_map>
 
 
 
@@ -27,9 +32,14 @@ class RoutingProtocol : public Ipv4RoutingProtocol
 public:
   static const uint32_t SDN_PORT;
   static ControlCenter NETCENTER;
+  static NodeRegistry REGISTRY;
 
   static TypeId GetTypeId(void);
 
+  typedef void (* TableMissTracedCallback)(const Ipv4Header & header);
+  typedef void (* RreqTracedCallback)(Ipv4Address src, Ipv4Address dst);
+  typedef void (* FlowSetupTracedCallback)(const Ipv4Header & header, Time latency);
+
 public:
   virtual Ptr<Ipv4Route> RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr);
   virtual bool RouteInput  (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
@@ -47,8 +57,31 @@ public:
   RoutingProtocol();
 
   void RecvControlPacket (Ptr<Socket> socket);
-
-  void RecvRREP(Ipv4Address,Ipv4Address,int);
+  void SendControl (ControlHeader header);
+
+  // in-band control messages sent or relayed by this node
+  uint64_t GetControlPackets () const;
+  uint64_t GetControlBytes () const;
+  // link states this node sent to the controller in hello reports
+  uint64_t GetLinkReports () const;
+
+  const FlowSetupStats & GetStats () const;
+  // every registered node's stats merged
+  static FlowSetupStats GetGlobalStats ();
+
+  // how flows are spread over the members of their next-hop group
+  void SetSprayMode (PathSprayer::Mode mode);
+  PathSprayer::Mode GetSprayMode () const;
+  void SetFlowletGap (Time gap);
+  Time GetFlowletGap () const;
+  const SprayStats & GetSprayStats (PathSprayer::Mode mode) const;
+  static SprayStats GetGlobalSprayStats (PathSprayer::Mode mode);
+
+  void RecvRREPBatch(std::vector<FlowInstall>);
+  void RecvTable(std::vector<FlowInstall>);
+  void QueueInstall(Time,Ipv4Address,Ipv4Address,const std::vector<std::pair<int,double>>&,int backup = -1);
+  void ReleaseFlow(Ipv4Address,Ipv4Address);
+  void RecvSourceRoute(Ipv4Address,Ipv4Address,std::vector<int>);
 
   void HelloTimerExpire ();
 
@@ -61,15 +94,24 @@ private:
   Ptr<Ipv4Route> LoopbackRoute (const Ipv4Header & header, Ptr<NetDevice> oif) const;
   void DeferredRouteOutput (Ptr<const Packet> p, const Ipv4Header & header, UnicastForwardCallback ucb, ErrorCallback ecb);
   void SendTo (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination);
+  void SendToController (ControlHeader header);
+  void RecvControl (const ControlHeader & header);
+  Ptr<Ipv4Route> NeighborRoute (const Ipv4Header & header, int32_t iface) const;
   bool IsMyOwnAddress (Ipv4Address src);
   bool Forwarding (Ptr<const Packet> p, const Ipv4Header & header,
                    UnicastForwardCallback ucb, ErrorCallback ecb);
+  uint32_t FlowHash (Ptr<const Packet> p, const Ipv4Header & header, bool ports) const;
+  bool IsControlPacket (Ptr<const Packet> p, const Ipv4Header & header) const;
+  Ptr<Ipv4Route> SelectRoute (Ipv4Address src, Ipv4Address dst, uint32_t flow, uint32_t bytes);
 
 //  void RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address src);
 
 //  void SendReply (ControlPacketHeader const & conPacHeader, Ipv4Route const & toOrigin);
 
   Ptr<Socket> FindSocketWithInterfaceAddress (Ipv4InterfaceAddress addr ) const;
+  void AddSocket (Ptr<Socket> socket, Ipv4InterfaceAddress iface);
+  void RemoveSocket (Ptr<Socket> socket);
+  void BuildLoopbackRoutes ();
 
 //  void RecvReply (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sender);
 
@@ -77,14 +119,34 @@ private:
 
 //  void RecvConfig(Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sender);
 
-  void SendPacketFromQueue (Ipv4Address src, Ipv4Address dst, Ptr<Ipv4Route> route);
+  void SendPacketFromQueue (Ipv4Address src, Ipv4Address dst);
+  bool SendQueueEntry (QueueEntry & queueEntry);
+
+  // false when no next hop of the group or backup is usable, nothing is installed
+  bool InstallGroup (Ipv4Address src, Ipv4Address dst, const std::vector<std::pair<int,double>>& nexts, int backup = -1);
+  Ptr<Ipv4Route> MakeRoute (Ipv4Address src, Ipv4Address dst, int next);
+  void ApplyPendingInstalls ();
+  bool IsSourceRouted (Ipv4Address src, Ipv4Address dst) const;
+  bool SendSourceRouted (Ptr<const Packet> p, Ipv4Header header, UnicastForwardCallback ucb);
+  bool ForwardSourceRouted (Ptr<const Packet> p, Ipv4Header header, UnicastForwardCallback ucb);
+  void RecordFlowSetup (const Ipv4Header & header, Time deferredAt);
+  void RefreshNeighborPorts ();
+  void ReportLinkChange (Ptr<NetDevice> dev, bool up);
 
   void SendHello ();
+  int GetIndex ();
+  bool IsReportDue (int neighbor, Time delay, double load);
 
 
 private:
   Ptr<NetDevice> m_lo;
   std::map< Ptr<Socket>, Ipv4InterfaceAddress > m_socketAddresses;
+  // indices over m_socketAddresses, kept in step by AddSocket/RemoveSocket
+  std::unordered_map<Ipv4Address, Ptr<Socket>, Ipv4AddressHash> m_addressSockets;
+  std::vector<Ipv4Address> m_localAddresses;   // sorted
+  // source address of the loopback routes, one per output device
+  std::map<Ptr<NetDevice>, Ipv4Address> m_loopbackSources;
+  Ipv4Address m_defaultLoopbackSource;
   Ptr<Ipv4> m_ipv4;
   RequestQueue m_queue;
 
@@ -93,8 +155,45 @@ private:
   Time m_interval;
 
   uint32_t m_seqNo;
+  int m_index;   // this node's index in REGISTRY
+  uint64_t m_controlPackets;
+  uint64_t m_controlBytes;
+  uint64_t m_linkReports;
+
+  FlowSetupStats m_stats;
+  TracedCallback<const Ipv4Header &> m_tableMissTrace;
+  TracedCallback<Ipv4Address, Ipv4Address> m_rreqTrace;
+  TracedCallback<const Ipv4Header &, Time> m_flowSetupTrace;
+
+  // triggered link-state updates: last reported value and time per neighbour
+  bool m_triggered;
+  Time m_delayThreshold;
+  double m_loadThreshold;
+  double m_relThreshold;
+  Time m_maxSilence;
+  struct LinkReport
+  {
+    Time at;
+    Time delay;
+    double load;
+  };
+  std::map<int, LinkReport> m_reported;
 
   FlowTable m_flowtable;
+  PathSprayer m_sprayer;
+
+  // entries sent by the controller, applied once their arrival time has passed
+  struct PendingInstall
+  {
+    Ipv4Address src;
+    Ipv4Address dst;
+    std::vector<std::pair<int,double> > nexts;
+    int backup;
+  };
+  std::multimap<Time, PendingInstall> m_installs;
+
+  // source routing: full path of the flows this switch is the ingress of
+  std::map<std::pair<Ipv4Address, Ipv4Address>, std::vector<int> > m_sourceRoutes;
 
 
 
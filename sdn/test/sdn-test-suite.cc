@@ -2,6 +2,23 @@
 
 // Include a header file from your module to test.
 #include "ns3/sdn.h"
+#include "ns3/sdn-helper.h"
+#include "ns3/sdn-controller-placement.h"
+#include "ns3/sdn-packet.h"
+#include "ns3/sdn-stats.h"
+#include "ns3/packet.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/config.h"
+#include "ns3/simulator.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -46,6 +63,1422 @@ SdnTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Connect 'a' and 'b' both ways in the controller's view
+static void
+AddLink (sdn::ControlCenter &center, int a, int b, Time delay, double load = 0)
+{
+  sdn::Edge edge;
+  edge.delay = delay;
+  edge.load = load;
+  center.ChangeG (a, b, 1);
+  center.ChangeG (b, a, 1);
+  center.ChangeEdge (a, b, edge);
+  center.ChangeEdge (b, a, edge);
+}
+
+// Yen's K-shortest paths on a small diamond 0-{1,2}-3 plus a detour 0-4-3
+class SdnKPathsTestCase : public TestCase
+{
+public:
+  SdnKPathsTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnKPathsTestCase::SdnKPathsTestCase ()
+  : TestCase ("Sdn K-shortest paths are loop-free and ordered by cost")
+{
+}
+
+void
+SdnKPathsTestCase::DoRun (void)
+{
+  sdn::ControlCenter center;
+  center.SetNum (5);
+  center.InitG ();
+  int links[5][3] = { {0, 1, 1}, {1, 3, 1}, {0, 2, 1}, {2, 3, 1}, {0, 4, 5} };
+  for (int i = 0; i < 5; ++i)
+    {
+      AddLink (center, links[i][0], links[i][1], MilliSeconds (links[i][2]));
+    }
+  sdn::Edge slow;
+  slow.delay = MilliSeconds (5);
+  center.ChangeG (4, 3, 1);
+  center.ChangeEdge (4, 3, slow);
+
+  std::vector<std::vector<int> > paths = center.CalculateKPaths (0, 3, 4);
+  NS_TEST_ASSERT_MSG_EQ (paths.size (), 3, "expected three simple paths");
+  NS_TEST_ASSERT_MSG_EQ (paths[0].size (), 3, "shortest path has two hops");
+  NS_TEST_ASSERT_MSG_EQ (paths[1].size (), 3, "second path is the other equal-cost branch");
+  NS_TEST_ASSERT_MSG_NE (paths[0][1], paths[1][1], "equal-cost paths use different branches");
+  NS_TEST_ASSERT_MSG_EQ (paths[2][1], 4, "the detour comes last");
+  NS_TEST_ASSERT_MSG_EQ (center.CalculatePath (3, 3).size (), 1, "path to itself is the node alone");
+
+  // the cached tree of node 0 must not survive a hello that changes a cost
+  int first = center.CalculatePath (0, 3)[1];
+  sdn::Edge slower;
+  slower.delay = MilliSeconds (10);
+  center.ChangeEdge (0, first, slower);
+  std::vector<int> path = center.CalculatePath (0, 3);
+  NS_TEST_ASSERT_MSG_EQ (path.size (), 3, "still two hops");
+  NS_TEST_ASSERT_MSG_NE (path[1], first, "the slowed branch is avoided");
+}
+
+// The control latency table follows hellos on the control path only
+class SdnControlDelayTestCase : public TestCase
+{
+public:
+  SdnControlDelayTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnControlDelayTestCase::SdnControlDelayTestCase ()
+  : TestCase ("Sdn control latency table is patched by hellos")
+{
+}
+
+void
+SdnControlDelayTestCase::DoRun (void)
+{
+  sdn::ControlCenter center;
+  center.SetNum (4);
+  center.InitG ();
+  for (int i = 0; i < 3; ++i)
+    {
+      AddLink (center, i, i + 1, MilliSeconds (i + 1));
+    }
+  center.SetController (2);
+  center.AddSwitchToController (0, 2);
+  center.AddSwitchToController (3, 2);
+
+  NS_TEST_ASSERT_MSG_EQ (center.CalculateDelay (0), MilliSeconds (3), "0-1-2 costs 1ms + 2ms");
+  NS_TEST_ASSERT_MSG_EQ (center.CalculateDelay (3), MilliSeconds (3), "3-2 costs 3ms");
+  NS_TEST_ASSERT_MSG_EQ (center.CalculateDelay (2), Seconds (0), "the controller reaches itself for free");
+
+  sdn::Edge slower;
+  slower.delay = MilliSeconds (5);
+  center.ChangeEdge (0, 1, slower);
+  center.ChangeEdge (1, 0, slower);
+  NS_TEST_ASSERT_MSG_EQ (center.CalculateDelay (0), MilliSeconds (7), "hello on the control path is applied");
+  NS_TEST_ASSERT_MSG_EQ (center.CalculateDelay (3), MilliSeconds (3), "unrelated switch is untouched");
+}
+
+// A snapshot written by the controller reads back through the mapped view
+class SdnSnapshotTestCase : public TestCase
+{
+public:
+  SdnSnapshotTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnSnapshotTestCase::SdnSnapshotTestCase ()
+  : TestCase ("Sdn controller snapshot round trip")
+{
+}
+
+void
+SdnSnapshotTestCase::DoRun (void)
+{
+  sdn::ControlCenter center;
+  center.SetNum (3);
+  center.InitG ();
+  for (int i = 0; i < 2; ++i)
+    {
+      AddLink (center, i, i + 1, MilliSeconds (i + 1), 0.5);
+    }
+  center.SetController (2);
+  center.AddSwitchToController (0, 2);
+  center.CalculateDelay (0);
+
+  std::string file = CreateTempDirFilename ("sdn-snapshot.bin");
+  NS_TEST_ASSERT_MSG_EQ (center.WriteSnapshot (file), true, "snapshot written");
+
+  sdn::SnapshotView view;
+  NS_TEST_ASSERT_MSG_EQ (view.Open (file), true, "snapshot mapped");
+  NS_TEST_ASSERT_MSG_EQ (view.GetHeader ().numNodes, 3, "node count");
+  NS_TEST_ASSERT_MSG_EQ (view.GetHeader ().edgeCount, 4, "edge count");
+  NS_TEST_ASSERT_MSG_EQ ((int) view.GetAdjacency (0, 1), 1, "0-1 connected");
+  NS_TEST_ASSERT_MSG_EQ ((int) view.GetAdjacency (0, 2), -1, "0-2 not connected");
+  NS_TEST_ASSERT_MSG_EQ (view.GetController (0), 2, "switch 0 belongs to 2");
+  NS_TEST_ASSERT_MSG_EQ (view.GetEdges ()[0].load, 0.5, "edge load kept");
+  NS_TEST_ASSERT_MSG_EQ (view.GetHeader ().pathCount, 1, "control path stored");
+  const sdn::SnapshotPath &path = view.GetPaths ()[0];
+  NS_TEST_ASSERT_MSG_EQ (path.length, 3, "control path 0-1-2");
+  NS_TEST_ASSERT_MSG_EQ (view.GetPathNodes (path)[2], 2, "path ends at the controller");
+  view.Close ();
+
+  // a header pointing past the data is refused
+  std::ifstream in (file.c_str (), std::ios::binary);
+  std::string image ((std::istreambuf_iterator<char> (in)), std::istreambuf_iterator<char> ());
+  sdn::SnapshotHeader header;
+  std::memcpy (&header, image.data (), sizeof (header));
+  std::string corrupt = CreateTempDirFilename ("sdn-snapshot-corrupt.bin");
+  for (int field = 0; field < 2; ++field)
+    {
+      std::string bad = image;
+      if (field == 0)
+        {
+          sdn::SnapshotHeader edges = header;
+          edges.edgeCount = 1000;
+          std::memcpy (&bad[0], &edges, sizeof (edges));
+        }
+      else
+        {
+          sdn::SnapshotPath longer;
+          std::memcpy (&longer, image.data () + header.pathOffset, sizeof (longer));
+          longer.length = header.pathNodeCount + 1;
+          std::memcpy (&bad[header.pathOffset], &longer, sizeof (longer));
+        }
+      std::ofstream out (corrupt.c_str (), std::ios::binary);
+      out.write (bad.data (), bad.size ());
+      out.close ();
+      NS_TEST_ASSERT_MSG_EQ (view.Open (corrupt), false, "corrupt snapshot rejected");
+    }
+}
+
+// Placement picks the centre of a line and respects the capacity cap
+class SdnPlacementTestCase : public TestCase
+{
+public:
+  SdnPlacementTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnPlacementTestCase::SdnPlacementTestCase ()
+  : TestCase ("Sdn controller placement")
+{
+}
+
+void
+SdnPlacementTestCase::DoRun (void)
+{
+  sdn::ControlCenter center;
+  center.SetNum (5);
+  center.InitG ();
+  for (int i = 0; i < 4; ++i)
+    {
+      AddLink (center, i, i + 1, MilliSeconds (1));
+    }
+
+  sdn::ControllerPlacement placement;
+  placement.AddSample (center);
+  sdn::ControllerPlacement::Result one = placement.Solve (1);
+  NS_TEST_ASSERT_MSG_EQ (one.controllers.size (), 1, "one controller");
+  NS_TEST_ASSERT_MSG_EQ (one.controllers[0], 2, "the middle of the line");
+
+  placement.SetObjective (sdn::ControllerPlacement::WORST);
+  placement.SetCapacity (3);
+  sdn::ControllerPlacement::Result two = placement.Solve (2);
+  NS_TEST_ASSERT_MSG_EQ (two.controllers.size (), 2, "two controllers");
+  std::vector<int> load (5, 0);
+  for (int s = 0; s < 5; ++s)
+    {
+      NS_TEST_ASSERT_MSG_NE (two.assignment[s], -1, "every switch placed");
+      ++load[two.assignment[s]];
+    }
+  for (int c = 0; c < 5; ++c)
+    {
+      NS_TEST_ASSERT_MSG_LT_OR_EQ (load[c], 3, "capacity respected");
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL (two.cost, 0.001, 1e-9, "nobody is more than one hop away");
+
+  placement.Apply (two, center);
+  NS_TEST_ASSERT_MSG_EQ (center.IsController (two.controllers[0]), true, "applied to the controller");
+}
+
+// Stitched inter-domain paths match the global shortest paths
+class SdnDomainRoutingTestCase : public TestCase
+{
+public:
+  SdnDomainRoutingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnDomainRoutingTestCase::SdnDomainRoutingTestCase ()
+  : TestCase ("Sdn hierarchical inter-domain paths")
+{
+}
+
+void
+SdnDomainRoutingTestCase::DoRun (void)
+{
+  // a ring of six with a chord, split in two domains of three
+  sdn::ControlCenter center;
+  center.SetNum (6);
+  center.InitG ();
+  int links[7][3] = { {0, 1, 1}, {1, 2, 2}, {2, 3, 3}, {3, 4, 1}, {4, 5, 2}, {5, 0, 6}, {1, 4, 9} };
+  for (int i = 0; i < 7; ++i)
+    {
+      AddLink (center, links[i][0], links[i][1], MilliSeconds (links[i][2]));
+    }
+  center.SetController (0);
+  center.SetController (3);
+  center.AddSwitchToController (1, 0);
+  center.AddSwitchToController (2, 0);
+  center.AddSwitchToController (4, 3);
+  center.AddSwitchToController (5, 3);
+
+  std::vector<std::vector<int> > flat;
+  for (int s = 0; s < 6; ++s)
+    {
+      for (int d = 0; d < 6; ++d)
+        {
+          flat.push_back (center.CalculatePath (s, d));
+        }
+    }
+
+  center.SetHierarchical (true);
+  for (int s = 0; s < 6; ++s)
+    {
+      for (int d = 0; d < 6; ++d)
+        {
+          std::vector<int> path = center.CalculatePath (s, d);
+          NS_TEST_ASSERT_MSG_EQ (path.front (), s, "path starts at the source");
+          NS_TEST_ASSERT_MSG_EQ (path.back (), d, "path ends at the destination");
+          NS_TEST_ASSERT_MSG_EQ ((path == flat[s * 6 + d]), true, "same path as the global search");
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (center.GetBorderCount (), 6, "every node has an inter-domain link");
+
+  // hellos and link changes refresh only the segments they touch
+  AddLink (center, 1, 4, MilliSeconds (1));
+  AddLink (center, 0, 1, MilliSeconds (20));
+  center.ChangeG (3, 4, -1);
+  center.ChangeG (4, 3, -1);
+  center.SetHierarchical (false);
+  for (int s = 0; s < 6; ++s)
+    {
+      for (int d = 0; d < 6; ++d)
+        {
+          flat[s * 6 + d] = center.CalculatePath (s, d);
+        }
+    }
+  center.SetHierarchical (true);
+  for (int s = 0; s < 6; ++s)
+    {
+      for (int d = 0; d < 6; ++d)
+        {
+          NS_TEST_ASSERT_MSG_EQ ((center.CalculatePath (s, d) == flat[s * 6 + d]), true, "same path after the changes");
+        }
+    }
+}
+
+// Address lookups survive the table growing and report unknown addresses
+class SdnRegistryTestCase : public TestCase
+{
+public:
+  SdnRegistryTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnRegistryTestCase::SdnRegistryTestCase ()
+  : TestCase ("Sdn node and address registry")
+{
+}
+
+void
+SdnRegistryTestCase::DoRun (void)
+{
+  sdn::NodeRegistry registry;
+  NS_TEST_ASSERT_MSG_EQ (registry.GetIndex (Ipv4Address ("10.1.1.1")), -1, "empty registry");
+  // consecutive addresses, as the address helper hands them out
+  for (uint32_t i = 0; i < 100; ++i)
+    {
+      registry.AddAddress (Ipv4Address (0x0a010100 + i), i / 4);
+    }
+  for (uint32_t i = 0; i < 100; ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (registry.GetIndex (Ipv4Address (0x0a010100 + i)), (int)(i / 4), "address maps to its node");
+    }
+  NS_TEST_ASSERT_MSG_EQ (registry.GetIndex (Ipv4Address (0x0a020100)), -1, "unknown address");
+  registry.AddAddress (Ipv4Address (0x0a010100), 7);
+  NS_TEST_ASSERT_MSG_EQ (registry.GetIndex (Ipv4Address (0x0a010100)), 7, "re-registering moves the address");
+  NS_TEST_ASSERT_MSG_EQ (registry.GetAddresses ().size (), 100, "no duplicate entries");
+  registry.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (registry.GetIndex (Ipv4Address (0x0a010101)), -1, "cleared");
+
+  // the controller turns away requests it has no node index for
+  sdn::ControlCenter center;
+  center.SetNum (2);
+  center.InitG ();
+  center.RecvRREQ (0, Ipv4Address (0x0a090901), Ipv4Address (0x0a090902));
+  NS_TEST_ASSERT_MSG_EQ (center.GetRreqUnknown (), 1, "unregistered addresses are rejected");
+}
+
+// Control messages survive serialization through a packet
+class SdnControlHeaderTestCase : public TestCase
+{
+public:
+  SdnControlHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnControlHeaderTestCase::SdnControlHeaderTestCase ()
+  : TestCase ("Sdn in-band control header")
+{
+}
+
+void
+SdnControlHeaderTestCase::DoRun (void)
+{
+  sdn::ControlHeader rrep (sdn::SDNTYPE_RREP);
+  sdn::FlowEntry flow;
+  flow.src = Ipv4Address (0x0a010101);
+  flow.dst = Ipv4Address (0x0a020202);
+  flow.nexts.push_back (std::make_pair (3, 0.25));
+  flow.nexts.push_back (std::make_pair (5, 0.75));
+  rrep.SetFlows (std::vector<sdn::FlowEntry> (1, flow));
+  rrep.SetRoute (0, 7, false);
+
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (rrep);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), rrep.GetSerializedSize (), "declared size is written");
+  sdn::ControlHeader got;
+  packet->RemoveHeader (got);
+  NS_TEST_ASSERT_MSG_EQ (got.IsValid (), true, "known type");
+  NS_TEST_ASSERT_MSG_EQ (got.GetType (), sdn::SDNTYPE_RREP, "type");
+  NS_TEST_ASSERT_MSG_EQ (got.GetOrigin (), 0, "origin");
+  NS_TEST_ASSERT_MSG_EQ (got.GetTarget (), 7, "target");
+  NS_TEST_ASSERT_MSG_EQ (got.GetSwitch (), 7, "a downward message follows the target's control path");
+  NS_TEST_ASSERT_MSG_EQ (got.GetFlows ().size (), 1, "one flow");
+  const sdn::FlowEntry & back = got.GetFlows ().front ();
+  NS_TEST_ASSERT_MSG_EQ ((back.src == flow.src && back.dst == flow.dst), true, "flow addresses");
+  NS_TEST_ASSERT_MSG_EQ (back.backup, -1, "no backup");
+  NS_TEST_ASSERT_MSG_EQ (back.nexts.size (), 2, "both next hops");
+  NS_TEST_ASSERT_MSG_EQ (back.nexts[1].first, 5, "next hop");
+  NS_TEST_ASSERT_MSG_EQ_TOL (back.nexts[1].second / back.nexts[0].second, 3, 1e-3, "weight ratio");
+
+  // summed path weights go above 1, the split must survive
+  sdn::FlowEntry summed = flow;
+  summed.nexts[0].second = 3.0;
+  summed.nexts[1].second = 1.0;
+  rrep.SetFlows (std::vector<sdn::FlowEntry> (1, summed));
+  packet = Create<Packet> ();
+  packet->AddHeader (rrep);
+  packet->RemoveHeader (got);
+  const sdn::FlowEntry & split = got.GetFlows ().front ();
+  NS_TEST_ASSERT_MSG_EQ_TOL (split.nexts[0].second / split.nexts[1].second, 3, 1e-3, "3:1 split kept");
+
+  sdn::ControlHeader hello (sdn::SDNTYPE_HELLO);
+  sdn::LinkState link;
+  link.neighbor = 2;
+  link.delay = MicroSeconds (1500);
+  link.load = 0.5;
+  hello.SetLinks (std::vector<sdn::LinkState> (1, link));
+  hello.SetRoute (4, 0, true);
+  packet = Create<Packet> ();
+  packet->AddHeader (hello);
+  packet->RemoveHeader (got);
+  NS_TEST_ASSERT_MSG_EQ (got.GetType (), sdn::SDNTYPE_HELLO, "type");
+  NS_TEST_ASSERT_MSG_EQ (got.GetSwitch (), 4, "an upward message follows the origin's control path");
+  NS_TEST_ASSERT_MSG_EQ (got.GetLinks ().front ().delay, MicroSeconds (1500), "delay");
+  NS_TEST_ASSERT_MSG_EQ_TOL (got.GetLinks ().front ().load, 0.5, 1e-4, "load");
+
+  // a source route shrinks by one hop per transit switch
+  std::vector<int> path;
+  path.push_back (1);
+  path.push_back (4);
+  path.push_back (6);
+  sdn::SourceRouteHeader sr (17);
+  sr.SetHops (path.begin (), path.end ());
+  packet = Create<Packet> ();
+  packet->AddHeader (sr);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 8, "two bytes plus two per hop");
+  for (uint32_t hop = 0; hop < path.size (); ++hop)
+    {
+      sdn::SourceRouteHeader transit;
+      packet->RemoveHeader (transit);
+      NS_TEST_ASSERT_MSG_EQ (transit.PopHop (), path[hop], "hops come out in path order");
+      packet->AddHeader (transit);
+    }
+  sdn::SourceRouteHeader last;
+  packet->RemoveHeader (last);
+  NS_TEST_ASSERT_MSG_EQ (last.IsEmpty (), true, "all hops popped");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t) last.GetProtocol (), 17, "the transport protocol is kept");
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 0, "the header is gone");
+
+  sdn::ControlHeader down (sdn::SDNTYPE_LINK);
+  down.SetLinkChange (std::vector<int> (1, 9), false, MilliSeconds (1250));
+  down.SetRoute (3, 0, true);
+  packet = Create<Packet> ();
+  packet->AddHeader (down);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), down.GetSerializedSize (), "declared size is written");
+  packet->RemoveHeader (got);
+  NS_TEST_ASSERT_MSG_EQ (got.GetType (), sdn::SDNTYPE_LINK, "type");
+  NS_TEST_ASSERT_MSG_EQ (got.IsLinkUp (), false, "link down");
+  NS_TEST_ASSERT_MSG_EQ (got.GetNeighbors ().size (), 1, "one neighbour");
+  NS_TEST_ASSERT_MSG_EQ (got.GetNeighbors ().front (), 9, "neighbour");
+  NS_TEST_ASSERT_MSG_EQ (got.GetTime (), MilliSeconds (1250), "detection time");
+}
+
+// A device going down takes its next hops out of the flow table
+class SdnFlowTablePurgeTestCase : public TestCase
+{
+public:
+  SdnFlowTablePurgeTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnFlowTablePurgeTestCase::SdnFlowTablePurgeTestCase ()
+  : TestCase ("Sdn flow table purge on device down")
+{
+}
+
+void
+SdnFlowTablePurgeTestCase::DoRun (void)
+{
+  Ptr<NetDevice> dead = CreateObject<SimpleNetDevice> ();
+  Ptr<NetDevice> live = CreateObject<SimpleNetDevice> ();
+  Ptr<Ipv4Route> viaDead = Create<Ipv4Route> ();
+  viaDead->SetOutputDevice (dead);
+  Ptr<Ipv4Route> viaLive = Create<Ipv4Route> ();
+  viaLive->SetOutputDevice (live);
+
+  Ipv4Address a ("10.0.0.1");
+  Ipv4Address b ("10.0.0.2");
+  Ipv4Address c ("10.0.0.3");
+  Ipv4Address d ("10.0.0.4");
+  sdn::FlowTable table;
+  // a group keeps its other member
+  sdn::NextHopGroup group;
+  group.Add (viaDead, 1);
+  group.Add (viaLive, 1);
+  table.Add (a, b, group);
+  // a single next hop falls back to its backup
+  table.Add (a, c, viaDead);
+  table.SetBackup (a, c, viaLive);
+  // a single next hop without backup is removed
+  table.Add (a, d, viaDead);
+  // untouched
+  table.Add (b, d, viaLive);
+  table.AddDestination (d, viaDead);
+
+  NS_TEST_ASSERT_MSG_EQ (table.PurgeDevice (dead), 4, "every dependent entry is touched");
+  NS_TEST_ASSERT_MSG_EQ (table.Get (a, b, 0), viaLive, "group member left");
+  NS_TEST_ASSERT_MSG_EQ (table.Get (a, b, 0xffffffff), viaLive, "only member left");
+  NS_TEST_ASSERT_MSG_EQ (table.Get (a, c), viaLive, "backup promoted");
+  NS_TEST_ASSERT_MSG_EQ (table.IsExist (a, d), false, "entry removed with the destination entry");
+  NS_TEST_ASSERT_MSG_EQ (table.Get (b, d), viaLive, "other entries kept");
+  NS_TEST_ASSERT_MSG_EQ (table.PurgeDevice (dead), 0, "nothing left on the device");
+
+  // the index follows replaced entries
+  table.Add (b, d, viaDead);
+  NS_TEST_ASSERT_MSG_EQ (table.PurgeDevice (live), 2, "the replaced entry is no longer indexed on its old device");
+  NS_TEST_ASSERT_MSG_EQ (table.Get (b, d), viaDead, "replaced entry kept");
+}
+
+// A lookup whose next hop leaves through a down device fails over to the
+// backup, then to another member of the group, and back once it is up
+class SdnFlowTableFailoverTestCase : public TestCase
+{
+public:
+  SdnFlowTableFailoverTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnFlowTableFailoverTestCase::SdnFlowTableFailoverTestCase ()
+  : TestCase ("Sdn flow table fails over to the backup next hop")
+{
+}
+
+void
+SdnFlowTableFailoverTestCase::DoRun (void)
+{
+  Ptr<NetDevice> primaryDev = CreateObject<SimpleNetDevice> ();
+  Ptr<NetDevice> backupDev = CreateObject<SimpleNetDevice> ();
+  Ptr<NetDevice> otherDev = CreateObject<SimpleNetDevice> ();
+  Ptr<Ipv4Route> primary = Create<Ipv4Route> ();
+  primary->SetOutputDevice (primaryDev);
+  Ptr<Ipv4Route> backup = Create<Ipv4Route> ();
+  backup->SetOutputDevice (backupDev);
+  Ptr<Ipv4Route> other = Create<Ipv4Route> ();
+  other->SetOutputDevice (otherDev);
+
+  Ipv4Address a ("10.0.0.1");
+  Ipv4Address b ("10.0.0.2");
+  Ipv4Address c ("10.0.0.3");
+  sdn::FlowTable table;
+  table.Add (a, b, primary);
+  table.SetBackup (a, b, backup);
+  sdn::NextHopGroup group;
+  group.Add (primary, 1);
+  group.Add (other, 1);
+  table.Add (a, c, group);
+  table.SetBackup (a, c, backup);
+  NS_TEST_ASSERT_MSG_EQ (table.Get (a, b), primary, "the primary while it is up");
+  NS_TEST_ASSERT_MSG_EQ (table.Get (a, c, 0), primary, "the hash selects the primary member");
+
+  table.SetDeviceUp (primaryDev, false);
+  NS_TEST_ASSERT_MSG_EQ (table.Get (a, b), backup, "the backup once the primary device is down");
+  NS_TEST_ASSERT_MSG_EQ (table.Get (a, c, 0), backup, "the backup before another member");
+  NS_TEST_ASSERT_MSG_EQ (table.IsExist (a, b), true, "the entry itself is kept");
+
+  table.SetDeviceUp (backupDev, false);
+  NS_TEST_ASSERT_MSG_EQ (table.Get (a, c, 0), other, "another member when the backup is down too");
+
+  table.SetDeviceUp (primaryDev, true);
+  table.SetDeviceUp (backupDev, true);
+  NS_TEST_ASSERT_MSG_EQ (table.Get (a, b), primary, "the primary again once it is back up");
+}
+
+// Log-bucketed latencies keep quantiles within one bucket width
+class SdnLatencyHistogramTestCase : public TestCase
+{
+public:
+  SdnLatencyHistogramTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnLatencyHistogramTestCase::SdnLatencyHistogramTestCase ()
+  : TestCase ("Sdn flow setup latency histogram")
+{
+}
+
+void
+SdnLatencyHistogramTestCase::DoRun (void)
+{
+  // every bucket starts where the previous one ends
+  for (uint32_t b = 0; b + 1 < 200; ++b)
+    {
+      NS_TEST_ASSERT_MSG_EQ (sdn::LatencyHistogram::Bucket (sdn::LatencyHistogram::Lower (b)), b, "lower edge is in its bucket");
+      NS_TEST_ASSERT_MSG_EQ (sdn::LatencyHistogram::Bucket (sdn::LatencyHistogram::Lower (b + 1) - 1), b, "upper edge is in its bucket");
+    }
+
+  sdn::LatencyHistogram first;
+  sdn::LatencyHistogram second;
+  for (int i = 1; i <= 100; ++i)
+    {
+      (i % 2 ? first : second).Add (MilliSeconds (i));
+    }
+  first.Merge (second);
+  NS_TEST_ASSERT_MSG_EQ (first.GetCount (), 100, "merged count");
+  NS_TEST_ASSERT_MSG_EQ (first.GetMin (), MilliSeconds (1), "min");
+  NS_TEST_ASSERT_MSG_EQ (first.GetMax (), MilliSeconds (100), "max");
+  NS_TEST_ASSERT_MSG_EQ_TOL (first.GetMean ().GetSeconds (), 0.0505, 1e-9, "mean");
+  double p50 = first.GetQuantile (0.5).GetSeconds ();
+  NS_TEST_ASSERT_MSG_EQ ((p50 >= 0.050 && p50 <= 0.050 * 1.125), true, "median within a bucket");
+  NS_TEST_ASSERT_MSG_EQ (first.GetQuantile (1), MilliSeconds (100), "top quantile is the max");
+}
+
+// Spraying modes spread a flow over its next-hop group as configured
+class SdnPathSprayerTestCase : public TestCase
+{
+public:
+  SdnPathSprayerTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnPathSprayerTestCase::SdnPathSprayerTestCase ()
+  : TestCase ("Sdn multipath spraying modes")
+{
+}
+
+void
+SdnPathSprayerTestCase::DoRun (void)
+{
+  Ipv4Address src ("10.0.0.1");
+  Ipv4Address dst ("10.0.0.2");
+  Ptr<Ipv4Route> light = Create<Ipv4Route> ();
+  light->SetGateway (Ipv4Address ("10.1.0.1"));
+  Ptr<Ipv4Route> heavy = Create<Ipv4Route> ();
+  heavy->SetGateway (Ipv4Address ("10.2.0.1"));
+  sdn::NextHopGroup group;
+  group.Add (light, 1);
+  group.Add (heavy, 3);
+  sdn::FlowTable table;
+  table.Add (src, dst, group);
+
+  sdn::PathSprayer sprayer;
+  uint32_t flow = 12345;
+  Ptr<Ipv4Route> first = sprayer.Select (table, src, dst, flow, 100, Seconds (0));
+  for (int i = 1; i < 100; ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (sprayer.Select (table, src, dst, flow, 100, MicroSeconds (i)), first, "a hashed flow stays put");
+    }
+  const sdn::SprayStats & hashed = sprayer.GetStats (sdn::PathSprayer::FLOW_HASH);
+  NS_TEST_ASSERT_MSG_EQ (hashed.packets, 100, "packets counted");
+  NS_TEST_ASSERT_MSG_EQ (hashed.bytes, 10000, "bytes counted");
+  NS_TEST_ASSERT_MSG_EQ (hashed.switches, 0, "no switches");
+
+  // per-packet spraying follows the weights
+  sprayer.SetMode (sdn::PathSprayer::ROUND_ROBIN);
+  uint32_t onHeavy = 0;
+  for (int i = 0; i < 400; ++i)
+    {
+      onHeavy += sprayer.Select (table, src, dst, flow, 100, MicroSeconds (i)) == heavy;
+    }
+  NS_TEST_ASSERT_MSG_EQ ((onHeavy >= 295 && onHeavy <= 305), true, "three quarters on the heavy member");
+  NS_TEST_ASSERT_MSG_EQ ((sprayer.GetStats (sdn::PathSprayer::ROUND_ROBIN).switches > 100), true, "packets alternate");
+  NS_TEST_ASSERT_MSG_EQ (sprayer.GetStats (sdn::PathSprayer::FLOW_HASH).packets, 100, "counted per mode");
+
+  // flowlets only move after an idle gap
+  sprayer.SetMode (sdn::PathSprayer::FLOWLET);
+  sprayer.SetFlowletGap (MicroSeconds (500));
+  Time now = Seconds (1);
+  bool used[2] = {false, false};
+  for (int burst = 0; burst < 40; ++burst)
+    {
+      Ptr<Ipv4Route> route = sprayer.Select (table, src, dst, flow, 100, now);
+      used[route == heavy] = true;
+      for (int i = 0; i < 10; ++i)
+        {
+          now += MicroSeconds (10);
+          NS_TEST_ASSERT_MSG_EQ (sprayer.Select (table, src, dst, flow, 100, now), route, "no move inside a flowlet");
+        }
+      now += MilliSeconds (1);
+    }
+  const sdn::SprayStats & flowlets = sprayer.GetStats (sdn::PathSprayer::FLOWLET);
+  NS_TEST_ASSERT_MSG_EQ (flowlets.flowlets, 40, "one flowlet per burst");
+  NS_TEST_ASSERT_MSG_EQ ((flowlets.switches > 0 && flowlets.switches < 40), true, "switches only between bursts");
+  NS_TEST_ASSERT_MSG_EQ ((used[0] && used[1]), true, "flowlets use both members");
+
+  // late arrivals are counted at the receiver
+  uint64_t uids[] = {1, 2, 4, 3, 5};
+  for (uint64_t uid : uids)
+    {
+      sprayer.Deliver (flow, uid, 100, now);
+    }
+  NS_TEST_ASSERT_MSG_EQ (flowlets.delivered, 5, "deliveries counted");
+  NS_TEST_ASSERT_MSG_EQ (flowlets.deliveredBytes, 500, "delivered bytes counted once per packet");
+  NS_TEST_ASSERT_MSG_EQ (flowlets.reordered, 1, "one late packet");
+
+  // receiver state of quiet flows is aged out: 2048 flows reach the
+  // second prune threshold, the next delivery drops the quiet ones
+  for (uint32_t f = 0; f < 2047; ++f)
+    {
+      sprayer.Deliver (f, 10, 100, now);
+    }
+  now += Seconds (5);
+  sprayer.Deliver (flow, 1, 100, now);
+  NS_TEST_ASSERT_MSG_EQ (flowlets.reordered, 1, "an aged-out flow starts over");
+}
+
+// One link of a test topology: its ends and the channel delay
+struct TestLink
+{
+  int a;
+  int b;
+  Time delay;
+};
+
+// 'n' nodes joined by 'links' on the static control center, every switch
+// is managed by the node at 'controller'
+static NodeContainer
+BuildNetwork (uint32_t n, const std::vector<TestLink> &links, int controller)
+{
+  NodeContainer c;
+  c.Create (n);
+  SDNHelper sdnh;
+  sdnh.Register (c);
+  sdn::RoutingProtocol::NETCENTER.SetNum (n);
+  sdn::RoutingProtocol::NETCENTER.InitG ();
+
+  NetDeviceContainer devices;
+  for (std::vector<TestLink>::const_iterator it = links.begin (); it != links.end (); ++it)
+    {
+      SimpleNetDeviceHelper link;
+      link.SetChannelAttribute ("Delay", TimeValue (it->delay));
+      devices.Add (link.Install (NodeContainer (c.Get (it->a), c.Get (it->b))));
+    }
+
+  sdn::RoutingProtocol::NETCENTER.Init (c);
+  sdn::RoutingProtocol::NETCENTER.SetController (controller);
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      sdn::RoutingProtocol::NETCENTER.AddSwitchToController (i, controller);
+    }
+
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (sdnh);
+  stack.Install (c);
+  Ipv4AddressHelper ip;
+  ip.SetBase ("10.1.1.0", "255.255.255.0");
+  ip.Assign (devices);
+  sdnh.RegisterAddresses (c);
+  return c;
+}
+
+// A line of 'n' nodes with 'delay' per link
+static NodeContainer
+BuildLine (uint32_t n, Time delay, int controller)
+{
+  std::vector<TestLink> links;
+  for (uint32_t i = 0; i + 1 < n; ++i)
+    {
+      TestLink link = {(int) i, (int) i + 1, delay};
+      links.push_back (link);
+    }
+  return BuildNetwork (n, links, controller);
+}
+
+// Take down the interface of 'node' on the link to 'neighbor'
+static void
+SetLinkDown (Ptr<Node> node, Ptr<Node> neighbor)
+{
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  for (uint32_t i = 0; i < node->GetNDevices (); ++i)
+    {
+      Ptr<Channel> channel = node->GetDevice (i)->GetChannel ();
+      if (!channel || channel->GetNDevices () != 2)
+        {
+          continue;
+        }
+      if (channel->GetDevice (0)->GetNode () == neighbor || channel->GetDevice (1)->GetNode () == neighbor)
+        {
+          ipv4->SetDown (ipv4->GetInterfaceForDevice (node->GetDevice (i)));
+          return;
+        }
+    }
+}
+
+// Undo BuildNetwork: the control center and the registry are shared by all cases
+static void
+TearDownNetwork (void)
+{
+  Simulator::Destroy ();
+  sdn::RoutingProtocol::REGISTRY.Clear ();
+  sdn::RoutingProtocol::NETCENTER = sdn::ControlCenter ();
+}
+
+// First address of 'node' that is not the loopback
+static Ipv4Address
+GetNodeAddress (Ptr<Node> node)
+{
+  return node->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+}
+
+static uint32_t g_forwarded;
+static Ipv4Address g_forwardedGateway;
+
+static void
+CountForwarded (Ptr<Ipv4Route> route, Ptr<const Packet> p, const Ipv4Header &header)
+{
+  ++g_forwarded;
+  g_forwardedGateway = route->GetGateway ();
+}
+
+// Hand one packet from 'from' to 'to' to the routing protocol the way
+// Ipv4L3Protocol does: a miss comes back in through the loopback and waits
+// for its flow entry
+static void
+SendPacket (Ptr<Node> from, Ptr<Node> to)
+{
+  Ptr<sdn::RoutingProtocol> rp = from->GetObject<sdn::RoutingProtocol> ();
+  Ptr<Packet> p = Create<Packet> (100);
+  Ipv4Header header;
+  header.SetSource (GetNodeAddress (from));
+  header.SetDestination (GetNodeAddress (to));
+  header.SetProtocol (17);
+  Socket::SocketErrno err;
+  Ptr<Ipv4Route> route = rp->RouteOutput (p, header, 0, err);
+  if (route->GetGateway () != Ipv4Address::GetLoopback ())
+    {
+      ++g_forwarded;
+      return;
+    }
+  rp->RouteInput (p, header, route->GetOutputDevice (), MakeCallback (&CountForwarded),
+                  MakeNullCallback<void, Ptr<Ipv4Route>, Ptr<const Packet>, const Ipv4Header &> (),
+                  MakeNullCallback<void, Ptr<const Packet>, const Ipv4Header &, uint32_t> (),
+                  MakeNullCallback<void, Ptr<const Packet>, const Ipv4Header &, Socket::SocketErrno> ());
+}
+
+// Hand one packet from 'from' to 'to' to the routing protocol of 'via' as
+// received on its first link
+static void
+ForwardPacket (Ptr<Node> from, Ptr<Node> via, Ptr<Node> to)
+{
+  Ipv4Header header;
+  header.SetSource (GetNodeAddress (from));
+  header.SetDestination (GetNodeAddress (to));
+  header.SetProtocol (17);
+  via->GetObject<sdn::RoutingProtocol> ()->RouteInput (
+    Create<Packet> (100), header, via->GetObject<Ipv4> ()->GetNetDevice (1), MakeCallback (&CountForwarded),
+    MakeNullCallback<void, Ptr<Ipv4Route>, Ptr<const Packet>, const Ipv4Header &> (),
+    MakeNullCallback<void, Ptr<const Packet>, const Ipv4Header &, uint32_t> (),
+    MakeNullCallback<void, Ptr<const Packet>, const Ipv4Header &, Socket::SocketErrno> ());
+}
+
+// With measured computation a RREQ is answered after the control delays,
+// its service time and its computation, which is charged once
+class SdnComputeChargeTestCase : public TestCase
+{
+public:
+  SdnComputeChargeTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnComputeChargeTestCase::SdnComputeChargeTestCase ()
+  : TestCase ("Sdn measured computation is charged once per RREQ")
+{
+}
+
+void
+SdnComputeChargeTestCase::DoRun (void)
+{
+  NodeContainer c = BuildLine (3, MilliSeconds (1), 1);
+  sdn::ControlCenter &center = sdn::RoutingProtocol::NETCENTER;
+  center.SetAttribute ("MeasureCompute", BooleanValue (true));
+  center.SetAttribute ("RreqServiceTime", TimeValue (MilliSeconds (10)));
+
+  g_forwarded = 0;
+  SendPacket (c.Get (0), c.Get (2));
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+
+  const sdn::LatencyHistogram &setup = c.Get (0)->GetObject<sdn::RoutingProtocol> ()->GetStats ().setup;
+  Time control = center.CalculateDelay (0);
+  Time base = control + MilliSeconds (10) + control;
+  NS_TEST_ASSERT_MSG_EQ (g_forwarded, 1, "the parked packet is released");
+  NS_TEST_ASSERT_MSG_EQ (setup.GetCount (), 1, "one flow set up");
+  NS_TEST_ASSERT_MSG_GT (center.GetComputeTime (), Seconds (0), "the computation is measured");
+  NS_TEST_ASSERT_MSG_GT (setup.GetMax (), base, "the reply leaves after the computation");
+  NS_TEST_ASSERT_MSG_LT_OR_EQ (setup.GetMax (), base + center.GetComputeTime (),
+                               "the computation is not charged twice");
+  TearDownNetwork ();
+}
+
+// A second RREQ for a flow whose entries are on their way is answered by
+// them, it is neither recomputed nor counted as a repair
+class SdnPendingReplyTestCase : public TestCase
+{
+public:
+  SdnPendingReplyTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnPendingReplyTestCase::SdnPendingReplyTestCase ()
+  : TestCase ("Sdn requests before the reply arrives are dropped")
+{
+}
+
+void
+SdnPendingReplyTestCase::DoRun (void)
+{
+  NodeContainer c = BuildLine (3, MilliSeconds (1), 1);
+  sdn::ControlCenter &center = sdn::RoutingProtocol::NETCENTER;
+
+  g_forwarded = 0;
+  SendPacket (c.Get (0), c.Get (2));
+  SendPacket (c.Get (0), c.Get (2));
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (center.GetPendingDrops (), 1, "the second request waits for the first answer");
+  NS_TEST_ASSERT_MSG_EQ (center.GetRepairs (), 0, "the installed path was not lost");
+  NS_TEST_ASSERT_MSG_EQ (center.GetReroutes (), 0, "nothing is recomputed");
+  NS_TEST_ASSERT_MSG_EQ (g_forwarded, 2, "both parked packets are released by the one answer");
+  TearDownNetwork ();
+}
+
+// A flow is moved when a link of its second path fails, not only one of
+// the path it was first given
+class SdnGroupEdgeFailureTestCase : public TestCase
+{
+public:
+  SdnGroupEdgeFailureTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnGroupEdgeFailureTestCase::SdnGroupEdgeFailureTestCase ()
+  : TestCase ("Sdn failure of a group member link reroutes the flow")
+{
+}
+
+void
+SdnGroupEdgeFailureTestCase::DoRun (void)
+{
+  // 0-1-3 is the shortest path, 0-2-3 the second member of the group at 0
+  std::vector<TestLink> links;
+  TestLink l01 = {0, 1, MilliSeconds (1)};
+  TestLink l13 = {1, 3, MilliSeconds (1)};
+  TestLink l02 = {0, 2, MilliSeconds (1)};
+  TestLink l23 = {2, 3, MicroSeconds (1500)};
+  links.push_back (l01);
+  links.push_back (l13);
+  links.push_back (l02);
+  links.push_back (l23);
+  NodeContainer c = BuildNetwork (4, links, 0);
+  sdn::ControlCenter &center = sdn::RoutingProtocol::NETCENTER;
+  center.SetPathCount (2);
+
+  g_forwarded = 0;
+  SendPacket (c.Get (0), c.Get (3));
+  Simulator::Schedule (MilliSeconds (100), &SetLinkDown, c.Get (2), c.Get (3));
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (g_forwarded, 1, "the flow is set up");
+  NS_TEST_ASSERT_MSG_EQ (center.GetLinkFailures (), 1, "the failure reaches the controller");
+  NS_TEST_ASSERT_MSG_EQ (center.GetFlowsRerouted (), 1, "the flow over the failed member is moved");
+  NS_TEST_ASSERT_MSG_EQ (center.GetReconvergence ().GetCount (), 1, "the reconvergence is measured");
+  TearDownNetwork ();
+}
+
+// The metric chosen through the attribute default decides the path: four
+// disjoint paths from 0 to 8, each the cheapest under one metric
+class SdnRoutingMetricTestCase : public TestCase
+{
+public:
+  SdnRoutingMetricTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnRoutingMetricTestCase::SdnRoutingMetricTestCase ()
+  : TestCase ("Sdn routing metric attribute selects the path")
+{
+}
+
+void
+SdnRoutingMetricTestCase::DoRun (void)
+{
+  // first hop, per-link delay and load of every path
+  struct
+  {
+    int first;
+    int hops;
+    Time delay;
+    double load;
+  } paths[] = {
+    {1, 2, MilliSeconds (10), 0.5},     // fewest hops
+    {2, 3, MilliSeconds (1), 0.9},      // lowest delay
+    {4, 3, MicroSeconds (1500), 0.2},   // lowest load-weighted delay
+    {6, 3, MilliSeconds (10), 0},       // most residual bandwidth
+  };
+  struct
+  {
+    sdn::ControlCenter::RoutingMetric metric;
+    int first;
+  } cases[] = {
+    {sdn::ControlCenter::HOP_COUNT, 1},
+    {sdn::ControlCenter::DELAY, 2},
+    {sdn::ControlCenter::LOAD_DELAY, 4},
+    {sdn::ControlCenter::RESIDUAL_BANDWIDTH, 6},
+  };
+
+  std::vector<TestLink> links;
+  for (uint32_t p = 0; p < 4; ++p)
+    {
+      int prev = 0;
+      for (int h = 0; h < paths[p].hops; ++h)
+        {
+          int next = h + 1 == paths[p].hops ? 8 : paths[p].first + h;
+          TestLink link = {prev, next, paths[p].delay};
+          links.push_back (link);
+          prev = next;
+        }
+    }
+
+  for (uint32_t i = 0; i < 4; ++i)
+    {
+      Config::SetDefault ("ns3::sdn::ControlCenter::RoutingMetric", EnumValue (cases[i].metric));
+      BuildNetwork (9, links, 0);
+      sdn::ControlCenter &center = sdn::RoutingProtocol::NETCENTER;
+      for (uint32_t p = 0; p < 4; ++p)
+        {
+          sdn::Edge edge;
+          edge.delay = paths[p].delay;
+          edge.load = paths[p].load;
+          int prev = 0;
+          for (int h = 0; h < paths[p].hops; ++h)
+            {
+              int next = h + 1 == paths[p].hops ? 8 : paths[p].first + h;
+              center.ChangeEdge (prev, next, edge);
+              center.ChangeEdge (next, prev, edge);
+              prev = next;
+            }
+        }
+      std::vector<int> path = center.CalculatePath (0, 8);
+      NS_TEST_ASSERT_MSG_EQ (path.size () > 1, true, "a path is found");
+      NS_TEST_ASSERT_MSG_EQ (path[1], cases[i].first, "metric " << i << " picks its own path");
+      TearDownNetwork ();
+    }
+  Config::SetDefault ("ns3::sdn::ControlCenter::RoutingMetric", EnumValue (sdn::ControlCenter::DELAY));
+}
+
+// Queued installs take effect in the order they arrive, not the order they
+// were queued, and a next hop whose device went down meanwhile is left out
+class SdnPendingInstallTestCase : public TestCase
+{
+public:
+  SdnPendingInstallTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnPendingInstallTestCase::SdnPendingInstallTestCase ()
+  : TestCase ("Sdn pending installs are applied in order and skip down devices")
+{
+}
+
+void
+SdnPendingInstallTestCase::DoRun (void)
+{
+  // 1 joins 0, 2 and 3; the flow 0 -> 3 is installed at 1 by hand
+  std::vector<TestLink> links;
+  TestLink l01 = {0, 1, MilliSeconds (1)};
+  TestLink l12 = {1, 2, MilliSeconds (1)};
+  TestLink l13 = {1, 3, MilliSeconds (1)};
+  links.push_back (l01);
+  links.push_back (l12);
+  links.push_back (l13);
+  NodeContainer c = BuildNetwork (4, links, 0);
+  sdn::ControlCenter &center = sdn::RoutingProtocol::NETCENTER;
+  Ptr<sdn::RoutingProtocol> rp = c.Get (1)->GetObject<sdn::RoutingProtocol> ();
+  Ipv4Address src = GetNodeAddress (c.Get (0));
+  Ipv4Address dst = GetNodeAddress (c.Get (3));
+  std::vector<std::pair<int, double> > via2 (1, std::make_pair (2, 1.0));
+  std::vector<std::pair<int, double> > via3 (1, std::make_pair (3, 1.0));
+
+  rp->QueueInstall (MilliSeconds (20), src, dst, via2);
+  rp->QueueInstall (MilliSeconds (10), src, dst, via3);
+  Simulator::Stop (MilliSeconds (30));
+  Simulator::Run ();
+  g_forwarded = 0;
+  ForwardPacket (c.Get (0), c.Get (1), c.Get (3));
+  NS_TEST_ASSERT_MSG_EQ (g_forwarded, 1, "the flow is installed");
+  NS_TEST_ASSERT_MSG_EQ (g_forwardedGateway, center.GetGateWay (1, 2), "the later install wins");
+
+  // the device to 2 goes down before the next install arrives
+  rp->QueueInstall (MilliSeconds (50), src, dst, via2, 3);
+  Simulator::Schedule (MilliSeconds (10), &SetLinkDown, c.Get (1), c.Get (2));
+  Simulator::Stop (MilliSeconds (30));
+  Simulator::Run ();
+  ForwardPacket (c.Get (0), c.Get (1), c.Get (3));
+  NS_TEST_ASSERT_MSG_EQ (g_forwarded, 2, "the flow stays installed");
+  NS_TEST_ASSERT_MSG_EQ (g_forwardedGateway, center.GetGateWay (1, 3), "the down next hop gives way to the backup");
+
+  // without a backup nothing usable is left, the entry is removed
+  rp->QueueInstall (MilliSeconds (70), src, dst, via2);
+  Simulator::Stop (MilliSeconds (20));
+  Simulator::Run ();
+  ForwardPacket (c.Get (0), c.Get (1), c.Get (3));
+  NS_TEST_ASSERT_MSG_EQ (g_forwarded, 2, "nothing is forwarded over the down device");
+  TearDownNetwork ();
+}
+
+// A loopback route handed out for a miss keeps its destination when the
+// next miss is routed
+class SdnLoopbackRouteTestCase : public TestCase
+{
+public:
+  SdnLoopbackRouteTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnLoopbackRouteTestCase::SdnLoopbackRouteTestCase ()
+  : TestCase ("Sdn loopback routes are not shared between packets")
+{
+}
+
+void
+SdnLoopbackRouteTestCase::DoRun (void)
+{
+  NodeContainer c = BuildLine (3, MilliSeconds (1), 0);
+  Ptr<sdn::RoutingProtocol> rp = c.Get (0)->GetObject<sdn::RoutingProtocol> ();
+  Ipv4Header header;
+  header.SetSource (GetNodeAddress (c.Get (0)));
+  header.SetProtocol (17);
+  Socket::SocketErrno err;
+
+  header.SetDestination (GetNodeAddress (c.Get (1)));
+  Ptr<Ipv4Route> first = rp->RouteOutput (Create<Packet> (100), header, 0, err);
+  header.SetDestination (GetNodeAddress (c.Get (2)));
+  Ptr<NetDevice> oif = c.Get (0)->GetObject<Ipv4> ()->GetNetDevice (1);
+  Ptr<Ipv4Route> second = rp->RouteOutput (Create<Packet> (100), header, oif, err);
+
+  NS_TEST_ASSERT_MSG_EQ (first->GetGateway (), Ipv4Address::GetLoopback (), "a miss is looped back");
+  NS_TEST_ASSERT_MSG_EQ (second->GetGateway (), Ipv4Address::GetLoopback (), "so is the second");
+  NS_TEST_ASSERT_MSG_EQ (first->GetDestination (), GetNodeAddress (c.Get (1)), "the first route keeps its destination");
+  NS_TEST_ASSERT_MSG_EQ (second->GetDestination (), GetNodeAddress (c.Get (2)), "the second has its own");
+  NS_TEST_ASSERT_MSG_EQ (second->GetSource (), GetNodeAddress (c.Get (0)), "the source is the address of the output device");
+  TearDownNetwork ();
+}
+
+// In triggered mode a link is reported when it is first seen, when its
+// delay moves beyond the absolute or the relative threshold, and after
+// MaxSilence without a report
+class SdnTriggeredUpdateTestCase : public TestCase
+{
+public:
+  SdnTriggeredUpdateTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnTriggeredUpdateTestCase::SdnTriggeredUpdateTestCase ()
+  : TestCase ("Sdn triggered link-state reports follow the thresholds")
+{
+}
+
+void
+SdnTriggeredUpdateTestCase::DoRun (void)
+{
+  NodeContainer c = BuildLine (2, MilliSeconds (1), 0);
+  Ptr<sdn::RoutingProtocol> rp = c.Get (0)->GetObject<sdn::RoutingProtocol> ();
+  Ptr<Channel> channel = c.Get (0)->GetDevice (0)->GetChannel ();
+  rp->SetAttribute ("HelloInterval", TimeValue (MilliSeconds (100)));
+  rp->SetAttribute ("TriggeredUpdates", BooleanValue (true));
+  rp->SetAttribute ("DelayThreshold", TimeValue (MicroSeconds (500)));
+  rp->SetAttribute ("RelativeThreshold", DoubleValue (0));
+  rp->SetAttribute ("MaxSilence", TimeValue (Seconds (10)));
+
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (rp->GetLinkReports (), 1, "a new link is reported once");
+
+  channel->SetAttribute ("Delay", TimeValue (MicroSeconds (1300)));
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (rp->GetLinkReports (), 1, "no report within the absolute threshold");
+
+  channel->SetAttribute ("Delay", TimeValue (MicroSeconds (1600)));
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (rp->GetLinkReports (), 2, "a report once the absolute threshold is crossed");
+
+  rp->SetAttribute ("DelayThreshold", TimeValue (Seconds (0)));
+  rp->SetAttribute ("RelativeThreshold", DoubleValue (0.5));
+  channel->SetAttribute ("Delay", TimeValue (MicroSeconds (2000)));
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (rp->GetLinkReports (), 2, "no report within the relative threshold");
+
+  channel->SetAttribute ("Delay", TimeValue (MicroSeconds (2500)));
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (rp->GetLinkReports (), 3, "a report once the relative threshold is crossed");
+
+  // the last report went out between 4 and 4.1 seconds
+  Simulator::Stop (Seconds (8.5));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (rp->GetLinkReports (), 3, "a stable link stays silent");
+  Simulator::Stop (Seconds (1.5));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (rp->GetLinkReports (), 4, "a keepalive after MaxSilence");
+  TearDownNetwork ();
+}
+
+// Requests of one source within the batch window are answered together
+// from a single shortest-path tree
+class SdnRreqBatchTestCase : public TestCase
+{
+public:
+  SdnRreqBatchTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnRreqBatchTestCase::SdnRreqBatchTestCase ()
+  : TestCase ("Sdn requests within the batch window are answered together")
+{
+}
+
+void
+SdnRreqBatchTestCase::DoRun (void)
+{
+  NodeContainer c = BuildLine (4, MilliSeconds (1), 0);
+  sdn::ControlCenter &center = sdn::RoutingProtocol::NETCENTER;
+  center.SetAttribute ("BatchWindow", TimeValue (MilliSeconds (10)));
+  // without the batch the requests would be answered one service time apart
+  center.SetAttribute ("RreqServiceTime", TimeValue (MilliSeconds (1)));
+
+  // the control paths are routed on their first use, by the first hellos;
+  // a slower last link then makes the cached trees stale
+  Simulator::Stop (MilliSeconds (200));
+  Simulator::Run ();
+  sdn::Edge slow;
+  slow.delay = MilliSeconds (2);
+  center.ChangeEdge (2, 3, slow);
+  center.ChangeEdge (3, 2, slow);
+  uint64_t trees = center.GetTreeComputations ();
+  g_forwarded = 0;
+  SendPacket (c.Get (0), c.Get (1));
+  SendPacket (c.Get (0), c.Get (2));
+  SendPacket (c.Get (0), c.Get (3));
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+
+  const sdn::LatencyHistogram &setup = c.Get (0)->GetObject<sdn::RoutingProtocol> ()->GetStats ().setup;
+  NS_TEST_ASSERT_MSG_EQ (g_forwarded, 3, "every parked packet is released");
+  NS_TEST_ASSERT_MSG_EQ (setup.GetCount (), 3, "three flows set up");
+  NS_TEST_ASSERT_MSG_EQ (setup.GetMin (), setup.GetMax (), "the three answers arrive together");
+  NS_TEST_ASSERT_MSG_EQ (center.GetTreeComputations () - trees, 1, "one tree answers the whole batch");
+  TearDownNetwork ();
+}
+
+// In proactive mode every switch gets a next hop per destination, packets
+// parked for a destination leave with its entry, and after the hold-down
+// only the entries whose next hop moved are pushed again
+class SdnProactiveTableTestCase : public TestCase
+{
+public:
+  SdnProactiveTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnProactiveTableTestCase::SdnProactiveTableTestCase ()
+  : TestCase ("Sdn proactive tables are installed and updated by difference")
+{
+}
+
+void
+SdnProactiveTableTestCase::DoRun (void)
+{
+  // a ring 0-1-2-3-0 without equal-cost paths, every node has two addresses
+  std::vector<TestLink> links;
+  TestLink l01 = {0, 1, MilliSeconds (1)};
+  TestLink l12 = {1, 2, MilliSeconds (1)};
+  TestLink l23 = {2, 3, MilliSeconds (1)};
+  TestLink l30 = {3, 0, MicroSeconds (1500)};
+  links.push_back (l01);
+  links.push_back (l12);
+  links.push_back (l23);
+  links.push_back (l30);
+  Config::SetDefault ("ns3::sdn::ControlCenter::Proactive", BooleanValue (true));
+  NodeContainer c = BuildNetwork (4, links, 0);
+  Config::SetDefault ("ns3::sdn::ControlCenter::Proactive", BooleanValue (false));
+  sdn::ControlCenter &center = sdn::RoutingProtocol::NETCENTER;
+
+  // sent before the first tables leave the controller
+  g_forwarded = 0;
+  SendPacket (c.Get (2), c.Get (0));
+  Simulator::Stop (MilliSeconds (200));
+  Simulator::Run ();
+  Ptr<sdn::RoutingProtocol> rp = c.Get (2)->GetObject<sdn::RoutingProtocol> ();
+  NS_TEST_ASSERT_MSG_EQ (center.GetTableUpdates (), 4, "every switch gets its table");
+  NS_TEST_ASSERT_MSG_EQ (center.GetTableEntries (), 24, "an entry per switch and remote address");
+  NS_TEST_ASSERT_MSG_EQ (g_forwarded, 1, "the parked packet is released");
+  NS_TEST_ASSERT_MSG_LT (rp->GetStats ().setup.GetMax (), center.CalculateDelay (2) + center.CalculateDelay (2),
+                         "by the table, before its request is answered");
+
+  SendPacket (c.Get (2), c.Get (0));
+  NS_TEST_ASSERT_MSG_EQ (g_forwarded, 2, "the table forwards at once");
+  NS_TEST_ASSERT_MSG_EQ (rp->GetStats ().rreqs, 1, "without another request");
+
+  // 0-1 turns slow: 0 and 1 reach each other and 2 reaches 0 the other way
+  // round; both ends report it within one hello interval, the hold-down
+  // outlasts that
+  center.SetAttribute ("ProactiveHoldDown", TimeValue (Seconds (1)));
+  Ptr<Channel> channel = c.Get (0)->GetDevice (0)->GetChannel ();
+  channel->SetAttribute ("Delay", TimeValue (MilliSeconds (10)));
+  Simulator::Stop (MilliSeconds (900));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (center.GetTableUpdates (), 4, "nothing is pushed during the hold-down");
+  Simulator::Stop (Seconds (1));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (center.GetTableUpdates (), 7, "switches 0, 1 and 2 get one update each");
+  NS_TEST_ASSERT_MSG_EQ (center.GetTableEntries (), 32, "holding only the four moved next hops");
+  TearDownNetwork ();
+}
+
+static uint32_t g_delivered;
+static uint8_t g_deliveredProtocol;
+
+static void
+CountDelivered (Ptr<const Packet> p, const Ipv4Header &header, uint32_t iif)
+{
+  ++g_delivered;
+  g_deliveredProtocol = header.GetProtocol ();
+}
+
+// Hand 'p' addressed to 'to' from 'from' to the routing protocol of 'to' as
+// received on its first link
+static void
+ReceivePacket (Ptr<Node> from, Ptr<Node> to, Ptr<Packet> p, uint8_t protocol)
+{
+  Ipv4Header header;
+  header.SetSource (GetNodeAddress (from));
+  header.SetDestination (GetNodeAddress (to));
+  header.SetProtocol (protocol);
+  header.SetPayloadSize (p->GetSize ());
+  to->GetObject<sdn::RoutingProtocol> ()->RouteInput (
+    p, header, to->GetObject<Ipv4> ()->GetNetDevice (1),
+    MakeNullCallback<void, Ptr<Ipv4Route>, Ptr<const Packet>, const Ipv4Header &> (),
+    MakeNullCallback<void, Ptr<Ipv4Route>, Ptr<const Packet>, const Ipv4Header &> (),
+    MakeCallback (&CountDelivered),
+    MakeNullCallback<void, Ptr<const Packet>, const Ipv4Header &, Socket::SocketErrno> ());
+}
+
+// Only data packets count as delivered for the spraying statistics, a
+// source-routed one without its source route
+class SdnDeliverDataTestCase : public TestCase
+{
+public:
+  SdnDeliverDataTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdnDeliverDataTestCase::SdnDeliverDataTestCase ()
+  : TestCase ("Sdn delivery statistics skip control packets")
+{
+}
+
+void
+SdnDeliverDataTestCase::DoRun (void)
+{
+  NodeContainer c = BuildLine (2, MilliSeconds (1), 0);
+  Ptr<sdn::RoutingProtocol> rp = c.Get (1)->GetObject<sdn::RoutingProtocol> ();
+  const sdn::SprayStats &stats = rp->GetSprayStats (rp->GetSprayMode ());
+
+  // UDP source and destination ports lead the payload
+  uint8_t control[12] = {0x12, 0x34, sdn::RoutingProtocol::SDN_PORT >> 8, sdn::RoutingProtocol::SDN_PORT & 0xff};
+  uint8_t data[12] = {0x12, 0x34, 0, 9};
+  g_delivered = 0;
+  ReceivePacket (c.Get (0), c.Get (1), Create<Packet> (control, 12), 17);
+  NS_TEST_ASSERT_MSG_EQ (g_delivered, 1, "the control packet is delivered");
+  NS_TEST_ASSERT_MSG_EQ (stats.delivered, 0, "but not counted");
+
+  ReceivePacket (c.Get (0), c.Get (1), Create<Packet> (data, 12), 17);
+  NS_TEST_ASSERT_MSG_EQ (stats.delivered, 1, "a data packet is counted");
+
+  Ptr<Packet> routed = Create<Packet> (data, 12);
+  routed->AddHeader (sdn::SourceRouteHeader (17));
+  ReceivePacket (c.Get (0), c.Get (1), routed, sdn::SourceRouteHeader::PROT_NUMBER);
+  NS_TEST_ASSERT_MSG_EQ (g_delivered, 3, "every packet is delivered");
+  NS_TEST_ASSERT_MSG_EQ (g_deliveredProtocol, 17, "the transport gets its own protocol back");
+  NS_TEST_ASSERT_MSG_EQ (stats.delivered, 2, "a source-routed data packet is counted");
+  NS_TEST_ASSERT_MSG_EQ (stats.deliveredBytes, 24, "without its source route");
+  TearDownNetwork ();
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -61,6 +1494,27 @@ SdnTestSuite::SdnTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new SdnTestCase1, TestCase::QUICK);
+  AddTestCase (new SdnKPathsTestCase, TestCase::QUICK);
+  AddTestCase (new SdnControlDelayTestCase, TestCase::QUICK);
+  AddTestCase (new SdnSnapshotTestCase, TestCase::QUICK);
+  AddTestCase (new SdnPlacementTestCase, TestCase::QUICK);
+  AddTestCase (new SdnDomainRoutingTestCase, TestCase::QUICK);
+  AddTestCase (new SdnRegistryTestCase, TestCase::QUICK);
+  AddTestCase (new SdnControlHeaderTestCase, TestCase::QUICK);
+  AddTestCase (new SdnLatencyHistogramTestCase, TestCase::QUICK);
+  AddTestCase (new SdnPathSprayerTestCase, TestCase::QUICK);
+  AddTestCase (new SdnFlowTablePurgeTestCase, TestCase::QUICK);
+  AddTestCase (new SdnComputeChargeTestCase, TestCase::QUICK);
+  AddTestCase (new SdnPendingReplyTestCase, TestCase::QUICK);
+  AddTestCase (new SdnGroupEdgeFailureTestCase, TestCase::QUICK);
+  AddTestCase (new SdnRoutingMetricTestCase, TestCase::QUICK);
+  AddTestCase (new SdnDeliverDataTestCase, TestCase::QUICK);
+  AddTestCase (new SdnPendingInstallTestCase, TestCase::QUICK);
+  AddTestCase (new SdnLoopbackRouteTestCase, TestCase::QUICK);
+  AddTestCase (new SdnTriggeredUpdateTestCase, TestCase::QUICK);
+  AddTestCase (new SdnRreqBatchTestCase, TestCase::QUICK);
+  AddTestCase (new SdnProactiveTableTestCase, TestCase::QUICK);
+  AddTestCase (new SdnFlowTableFailoverTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
@@ -24,6 +24,24 @@ SdsnHelper::Create(Ptr<Node> no) const
   return agent;
 }
 
+void
+SdsnHelper::PrintReconvergence(std::ostream& os) const
+{
+  const sdsn::NetView& view = sdsn::RoutingProtocol::LogCen;
+  const std::vector<Time>& times = view.GetReconvergence();
+  Time total = Seconds(0);
+  Time worst = Seconds(0);
+  for(std::vector<Time>::const_iterator it = times.begin(); it != times.end(); ++it)
+    {
+      total += *it;
+      worst = std::max(worst,*it);
+    }
+  os << "link failures " << view.GetLinkFailures()
+     << " control paths repaired " << view.GetControlPathRepairs()
+     << " reconvergence mean " << (times.empty() ? 0 : total.GetSeconds() / times.size()) << "s"
+     << " max " << worst.GetSeconds() << "s" << std::endl;
+}
+
 
 /* ... */
 
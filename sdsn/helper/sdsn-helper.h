@@ -19,6 +19,10 @@ public:
 
   SdsnHelper();
 
+  // link failures seen by the view, control paths moved off them and the
+  // reconvergence time per failure
+  void PrintReconvergence(std::ostream& os) const;
+
 private:
   ObjectFactory m_agentFactory;
 
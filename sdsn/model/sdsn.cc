@@ -1,6 +1,9 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
 #include "sdsn.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 
 std::map<ns3::Ptr<ns3::Node>,std::pair<int,int>> NodeToIndex;
 std::map<std::pair<int,int>,ns3::Ptr<ns3::Node>> IndexToNode;
@@ -22,6 +25,8 @@ NS_OBJECT_ENSURE_REGISTERED (RoutingProtocol);
 const uint32_t RoutingProtocol::SDSN_PORT = 654;
 
 NetView::NetView()
+  : m_linkFailures(0),
+    m_controlRepairs(0)
 {
 
 }
@@ -44,83 +49,94 @@ std::ostream & operator<< (std::ostream & os, TypeHeader const & h)
 void
 NetView::Install(NodeContainer c)
 {
+  //the rows of the new nodes go after the ones already there
+  if(m_offsets.empty()) m_offsets.push_back(0);
   uint32_t node_num = c.GetN();
   for(uint32_t i = 0; i < node_num; i++)
     {
-      uint32_t device_num = c.Get(i)->GetNDevices();
-      std::list<std::pair<Ptr<Node>,NetViewEdge>> temp;
-      temp.push_back(std::make_pair(c.Get(i),NetViewEdge()));
+      Ptr<Node> node = c.Get(i);
+      if(node->GetId() >= m_indexOfId.size()) m_indexOfId.resize(node->GetId() + 1, -1);
+      m_indexOfId[node->GetId()] = m_nodes.size();
+      m_nodes.push_back(node);
+      uint32_t device_num = node->GetNDevices();
       for(uint32_t j = 0; j < device_num; j++)
         {
-          Ptr<NetDevice> dev = c.Get(i)->GetDevice(j);
+          Ptr<NetDevice> dev = node->GetDevice(j);
           Ptr<Channel> cha = dev->GetChannel();
           if(cha)
             {
               if(cha->GetNDevices() == 2)
                 {
                   Ptr<NetDevice> odev = cha->GetDevice(0) == dev ? cha->GetDevice(1) : cha->GetDevice(0);
-                  temp.push_back(std::make_pair(odev->GetNode(),NetViewEdge(dev,odev,cha)));
+                  uint64_t key = (uint64_t)node->GetId() << 32 | odev->GetNode()->GetId();
+                  m_slotOf.insert(std::make_pair(key,(uint32_t)m_edges.size()));
+                  m_edges.push_back(std::make_pair(odev->GetNode(),NetViewEdge(dev,odev,cha)));
                 }
             }
         }
-      m_view.insert(std::make_pair(c.Get(i),temp));
+      m_offsets.push_back(m_edges.size());
     }
 }
 
+int32_t
+NetView::IndexOf(Ptr<Node> node) const
+{
+  if(!node || node->GetId() >= m_indexOfId.size()) return -1;
+  return m_indexOfId[node->GetId()];
+}
+
+NetView::Slot*
+NetView::FindEdge(Ptr<Node> node1, Ptr<Node> node2)
+{
+  if(!node1 || !node2) return 0;
+  std::unordered_map<uint64_t,uint32_t>::iterator it =
+    m_slotOf.find((uint64_t)node1->GetId() << 32 | node2->GetId());
+  if(it == m_slotOf.end()) return 0;
+  return &m_edges[it->second];
+}
+
+std::pair<NetView::Slot*,NetView::Slot*>
+NetView::GetEdges(Ptr<Node> node)
+{
+  int32_t n = IndexOf(node);
+  if(n < 0) return std::make_pair((Slot*)0,(Slot*)0);
+  Slot* base = m_edges.data();
+  return std::make_pair(base + m_offsets[n],base + m_offsets[n + 1]);
+}
+
 std::pair<Time,Time>
 NetView::GetDelay(Ptr<Node> node1, Ptr<Node> node2)
 {
-  for(Adjlist::iterator it = m_view.begin(); it != m_view.end(); it++)
-    {
-      if(it->second.begin()->first == node1)
-        {
-          for(LList::iterator iter = it->second.begin(); iter != it->second.end(); iter++)
-            {
-              if(iter->first == node2)
-                {
-                  return std::make_pair(Simulator::Now(),iter->second.GetDelay());
-                }
-            }
-        }
-    }
+  Slot* edge = FindEdge(node1,node2);
+  if(edge) return std::make_pair(Simulator::Now(),edge->second.GetDelay());
   return std::make_pair(Simulator::Now(),Seconds(99999));
 }
 
 std::pair<Time,double>
 NetView::GetLoad(Ptr<Node> node1, Ptr<Node> node2)
 {
-  for(Adjlist::iterator it = m_view.begin(); it != m_view.end(); it++)
-    {
-      if(it->second.begin()->first == node1)
-        {
-          for(LList::iterator iter = it->second.begin(); iter != it->second.end(); iter++)
-            {
-              if(iter->first == node2)
-                {
-                  return std::make_pair(Simulator::Now(),iter->second.GetLoad());
-                }
-            }
-        }
-    }
+  Slot* edge = FindEdge(node1,node2);
+  if(edge) return std::make_pair(Simulator::Now(),edge->second.GetLoad());
   return std::make_pair(Simulator::Now(),1);
 }
 
 void
 NetView::InitSnap()
 {
-  for(auto it = m_view.begin(); it != m_view.end(); ++it)
+  for(uint32_t n = 0; n < m_nodes.size(); ++n)
     {
-      for(auto iter = it->second.begin(); iter != it->second.end(); ++iter)
+      Ptr<Node> node = m_nodes[n];
+      m_snap.insert({std::make_pair(node,node),
+                    std::make_pair(Seconds(0),NodeInfo())}
+                    );
+      for(uint32_t e = m_offsets[n]; e < m_offsets[n + 1]; ++e)
         {
-
-          m_snap.insert({std::make_pair(it->first,iter->first),
-                        std::make_pair(Seconds(0),NodeInfo())}
-                        );
-          if(iter->first == it->first) continue;
-
-          m_snap.find(std::make_pair(it->first,iter->first))->second.first = Seconds(0); //timestamp
-          m_snap.find(std::make_pair(it->first,iter->first))->second.second.SetDelay(iter->second.GetDelay());
-          m_snap.find(std::make_pair(it->first,iter->first))->second.second.SetLoad(iter->second.GetLoad());
+          Slot& slot = m_edges[e];
+          if(!slot.second.IsUp()) continue;
+          std::pair<Time,NodeInfo>& snap = m_snap[std::make_pair(node,slot.first)];
+          snap.first = Seconds(0); //timestamp
+          snap.second.SetDelay(slot.second.GetDelay());
+          snap.second.SetLoad(slot.second.GetLoad());
         }
     }
 }
@@ -134,6 +150,57 @@ NetView::UpdateSnap(Ptr<Node> master, Ptr<Node> slave, Time time ,Time delay, do
   m_snap.find({master,slave})->second.second.SetLoad(load);
 }
 
+bool
+NetView::WriteSnap(std::string filename) const
+{
+  SnapHeader header;
+  std::memset (&header, 0, sizeof (header));
+  std::memcpy (header.magic, "SDSNSNAP", 8);
+  header.version = 1;
+  header.recordSize = sizeof (SnapRecord);
+  header.time = Simulator::Now ().GetNanoSeconds ();
+  header.recordCount = m_snap.size ();
+  header.recordOffset = sizeof (SnapHeader);
+
+  // assemble the whole image first so a dump costs a single write
+  std::vector<SnapRecord> records;
+  records.reserve (m_snap.size ());
+  for (auto it = m_snap.begin (); it != m_snap.end (); ++it)
+    {
+      SnapRecord rec;
+      rec.master = it->first.first->GetId ();
+      rec.slave = it->first.second->GetId ();
+      rec.timestamp = it->second.first.GetNanoSeconds ();
+      rec.delay = it->second.second.GetDelay ().GetNanoSeconds ();
+      rec.load = it->second.second.GetLoad ();
+      records.push_back (rec);
+    }
+
+  FILE *f = std::fopen (filename.c_str (), "wb");
+  if (!f)
+    {
+      return false;
+    }
+  bool ok = std::fwrite (&header, sizeof (header), 1, f) == 1;
+  if (!records.empty ())
+    {
+      ok = ok && std::fwrite (&records[0], sizeof (SnapRecord), records.size (), f) == records.size ();
+    }
+  return std::fclose (f) == 0 && ok;
+}
+
+void
+NetView::ScheduleSnap (Time at, std::string filename)
+{
+  Simulator::Schedule (at, &NetView::WriteSnapEvent, this, filename);
+}
+
+void
+NetView::WriteSnapEvent (std::string filename)
+{
+  WriteSnap (filename);
+}
+
 void
 RoutingProtocol::SendHello ()
 {
@@ -148,22 +215,14 @@ RoutingProtocol::SendHello ()
   if(m_type == CONTROLLER)
     {
       Ptr<Node> no = this->GetObject<Node>();
-      Ptr<Channel> cha;
-      Ptr<NetDevice> dev;
-      Ptr<Node> ono;
-      Ptr<NetDevice> odev;
+      std::pair<NetView::Slot*,NetView::Slot*> edges = LogCen.GetEdges(no);
 
-      for(uint32_t i = 0; i < no->GetNDevices(); ++i)
+      for(NetView::Slot* it = edges.first; it != edges.second; ++it)
         {
-          dev = no->GetDevice(i);
-          cha = dev->GetChannel();
-          if(cha)
-            {
-              odev = cha->GetDevice(0) == dev ? cha->GetDevice(1) : cha->GetDevice(0);
-              ono = odev->GetNode();
-
-              LogCen.UpdateSnap(no, ono, Simulator::Now(), LogCen.GetDelay(no, ono).second ,LogCen.GetLoad(no, ono).second);
-            }
+          if(it->second.IsUp())
+            LogCen.UpdateSnap(no, it->first, Simulator::Now(), it->second.GetDelay(), it->second.GetLoad());
+          else
+            LogCen.UpdateSnap(no, it->first, Simulator::Now(), Seconds(99999), 1);
         }
 
       return;
@@ -183,39 +242,17 @@ RoutingProtocol::SendHello ()
 
 
   Ptr<Node> no = this->GetObject<Node>();
-  Ptr<Node> ono;
-
-  Ptr<NetDevice> dev;
-  Ptr<NetDevice> odev;
-  Ptr<Channel> cha;
   NodeInfo ni;
 
-  for(uint32_t i = 0; i < no->GetNDevices(); ++i)
-    {
-      dev = no->GetDevice(i);
-      cha = dev->GetChannel();
-      if(cha)
-        {
-          odev = cha->GetDevice(0) == dev ? cha->GetDevice(1) : cha->GetDevice(0);
-
-          ono = odev->GetNode();
+  std::map<std::pair<Ptr<Node>,Ptr<Node>>,std::pair<Time,NodeInfo>>& cache = LogCen.m_cache[m_outSocket.second.GetLocal()];
+  std::pair<NetView::Slot*,NetView::Slot*> edges = LogCen.GetEdges(no);
 
-          ni.SetDelay(LogCen.GetDelay(no, ono).second);
-          ni.SetLoad(LogCen.GetLoad(no,ono).second);
-          if(LogCen.m_cache.count(m_outSocket.second.GetLocal()))
-            {
-              if(LogCen.m_cache.find(m_outSocket.second.GetLocal()) ->second.count({no,ono}))
-                LogCen.m_cache.find(m_outSocket.second.GetLocal())->second.find({no,ono})->second = {Simulator::Now(),ni};
-              else
-                LogCen.m_cache.find(m_outSocket.second.GetLocal())->second.insert({{no,ono},{Simulator::Now(),ni}});
-            }
-          else
-            {
-              std::map<std::pair<Ptr<Node>,Ptr<Node>>,std::pair<Time,NodeInfo>> temp;
-              temp[{no,ono}] = {Simulator::Now(),ni};
-              LogCen.m_cache[m_outSocket.second.GetLocal()] = temp;
-            }
-        }
+  for(NetView::Slot* it = edges.first; it != edges.second; ++it)
+    {
+      //a link gone down is still reported, as unusable
+      ni.SetDelay(it->second.IsUp() ? it->second.GetDelay() : Seconds(99999));
+      ni.SetLoad(it->second.IsUp() ? it->second.GetLoad() : 1);
+      cache[{no,it->first}] = {Simulator::Now(),ni};
     }
 
   //LogCen.
@@ -259,6 +296,24 @@ RoutingTable::LookupRoute (Ipv4Address id, Ipv4Route & rt)
   return true;
 }
 
+uint32_t
+RoutingTable::DeleteRoutesThrough (Ptr<NetDevice> dev)
+{
+  std::map<Ptr<NetDevice>, std::set<Ipv4Address> >::iterator it = m_deviceRoutes.find (dev);
+  if (it == m_deviceRoutes.end ())
+    {
+      return 0;
+    }
+  uint32_t n = it->second.size ();
+  for (std::set<Ipv4Address>::const_iterator dst = it->second.begin (); dst != it->second.end (); ++dst)
+    {
+      m_table.erase (*dst);
+    }
+  m_deviceRoutes.erase (it);
+  NS_LOG_LOGIC ("Deleted " << n << " routes through a device gone down");
+  return n;
+}
+
 TypeId
 RoutingProtocol::GetTypeId (void)
 {
@@ -274,20 +329,54 @@ Ptr<Socket>
 RoutingProtocol::FindSocketWithInterfaceAddress (Ipv4InterfaceAddress addr ) const
 {
   NS_LOG_FUNCTION (this << addr);
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
-         m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
+  std::unordered_map<Ipv4Address, Ptr<Socket>, Ipv4AddressHash>::const_iterator it =
+    m_addressSockets.find (addr.GetLocal ());
+  if (it != m_addressSockets.end () && m_socketAddresses.find (it->second)->second == addr)
     {
-      Ptr<Socket> socket = j->first;
-      Ipv4InterfaceAddress iface = j->second;
-      if (iface == addr)
-        {
-          return socket;
-        }
+      return it->second;
     }
   Ptr<Socket> socket;
   return socket;
 }
 
+void
+RoutingProtocol::AddSocket (Ptr<Socket> socket, Ipv4InterfaceAddress iface)
+{
+  m_socketAddresses.insert (std::make_pair (socket, iface));
+  m_addressSockets[iface.GetLocal ()] = socket;
+  std::vector<Ipv4Address>::iterator pos =
+    std::lower_bound (m_localAddresses.begin (), m_localAddresses.end (), iface.GetLocal ());
+  if (pos == m_localAddresses.end () || *pos != iface.GetLocal ())
+    {
+      m_localAddresses.insert (pos, iface.GetLocal ());
+    }
+  BuildLoopbackRoutes ();
+}
+
+void
+RoutingProtocol::RemoveSocket (Ptr<Socket> socket)
+{
+  std::map<Ptr<Socket>, Ipv4InterfaceAddress>::iterator it = m_socketAddresses.find (socket);
+  if (it == m_socketAddresses.end ())
+    {
+      return;
+    }
+  Ipv4Address local = it->second.GetLocal ();
+  m_socketAddresses.erase (it);
+  std::unordered_map<Ipv4Address, Ptr<Socket>, Ipv4AddressHash>::iterator byAddr = m_addressSockets.find (local);
+  if (byAddr != m_addressSockets.end () && byAddr->second == socket)
+    {
+      m_addressSockets.erase (byAddr);
+      std::vector<Ipv4Address>::iterator pos =
+        std::lower_bound (m_localAddresses.begin (), m_localAddresses.end (), local);
+      if (pos != m_localAddresses.end () && *pos == local)
+        {
+          m_localAddresses.erase (pos);
+        }
+    }
+  BuildLoopbackRoutes ();
+}
+
 Ptr<Ipv4Route>
 RoutingProtocol::RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
 {
@@ -337,8 +426,25 @@ RoutingProtocol::LoopbackRoute (const Ipv4Header & hdr, Ptr<NetDevice> oif) cons
 {
   NS_LOG_FUNCTION (this << hdr);
   NS_ASSERT (m_lo != 0);
+  Ipv4Address source = m_defaultLoopbackSource;
+  if (oif)
+    {
+      std::map<Ptr<NetDevice>, Ipv4Address>::const_iterator it = m_loopbackSources.find (oif);
+      source = it == m_loopbackSources.end () ? Ipv4Address () : it->second;
+    }
+  NS_ASSERT_MSG (source.IsInitialized (), "Valid SDSN source address not found");
+  // callers may keep the route, every one gets its own
   Ptr<Ipv4Route> rt = Create<Ipv4Route> ();
+  rt->SetSource (source);
   rt->SetDestination (hdr.GetDestination ());
+  rt->SetGateway (Ipv4Address::GetLoopback ());
+  rt->SetOutputDevice (m_lo);
+  return rt;
+}
+
+void
+RoutingProtocol::BuildLoopbackRoutes ()
+{
   //
   // Source address selection here is tricky.  The loopback route is
   // returned when AODV does not have a route; this causes the packet
@@ -349,35 +455,23 @@ RoutingProtocol::LoopbackRoute (const Ipv4Header & hdr, Ptr<NetDevice> oif) cons
   // AODV needs to guess correctly what the eventual source address
   // will be.
   //
-  // For single interface, single address nodes, this is not a problem.
-  // When there are possibly multiple outgoing interfaces, the policy
-  // implemented here is to pick the first available AODV interface.
-  // If RouteOutput() caller specified an outgoing interface, that
-  // further constrains the selection of source address
-  //
-  std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j = m_socketAddresses.begin ();
-  if (oif)
+  m_loopbackSources.clear ();
+  m_defaultLoopbackSource = Ipv4Address ();
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
+         m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
     {
-      // Iterate to find an address on the oif device
-      for (j = m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
+      Ipv4Address addr = j->second.GetLocal ();
+      int32_t interface = m_ipv4->GetInterfaceForAddress (addr);
+      if (!m_defaultLoopbackSource.IsInitialized ())
         {
-          Ipv4Address addr = j->second.GetLocal ();
-          int32_t interface = m_ipv4->GetInterfaceForAddress (addr);
-          if (oif == m_ipv4->GetNetDevice (static_cast<uint32_t> (interface)))
-            {
-              rt->SetSource (addr);
-              break;
-            }
+          m_defaultLoopbackSource = addr;
+        }
+      if (interface >= 0)
+        {
+          // the first address found on a device wins, as the scan did before
+          m_loopbackSources.insert (std::make_pair (m_ipv4->GetNetDevice (static_cast<uint32_t> (interface)), addr));
         }
     }
-  else
-    {
-      rt->SetSource (j->second.GetLocal ());
-    }
-  NS_ASSERT_MSG (rt->GetSource () != Ipv4Address (), "Valid SDSN source address not found");
-  rt->SetGateway (Ipv4Address ("127.0.0.1"));
-  rt->SetOutputDevice (m_lo);
-  return rt;
 }
 
 void
@@ -425,16 +519,7 @@ bool
 RoutingProtocol::IsMyOwnAddress (Ipv4Address src)
 {
   NS_LOG_FUNCTION (this << src);
-  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
-         m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
-    {
-      Ipv4InterfaceAddress iface = j->second;
-      if (src == iface.GetLocal ())
-        {
-          return true;
-        }
-    }
-  return false;
+  return std::binary_search (m_localAddresses.begin (), m_localAddresses.end (), src);
 }
 
 bool
@@ -744,7 +829,7 @@ RoutingProtocol::NotifyInterfaceUp (uint32_t i)
   socket->Bind (InetSocketAddress (iface.GetLocal (), SDSN_PORT));
   socket->SetAllowBroadcast (false);
   socket->SetIpRecvTtl (true);
-  m_socketAddresses.insert (std::make_pair (socket, iface));
+  AddSocket (socket, iface);
 
   // create also a subnet broadcast socket
 //  socket = Socket::CreateSocket (GetObject<Node> (),
@@ -792,12 +877,15 @@ RoutingProtocol::NotifyInterfaceDown (uint32_t i)
   Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
   Ptr<NetDevice> dev = l3->GetNetDevice (i);
 
+  // routes through the device go, the controller moves control paths off it
+  DeleteRoutesThrough (dev);
+  LogCen.LinkDown (GetObject<Node> (), dev);
 
   // Close socket
   Ptr<Socket> socket = FindSocketWithInterfaceAddress (m_ipv4->GetAddress (i, 0));
   NS_ASSERT (socket);
   socket->Close ();
-  m_socketAddresses.erase (socket);
+  RemoveSocket (socket);
 
 
 
@@ -807,7 +895,6 @@ RoutingProtocol::NotifyInterfaceDown (uint32_t i)
 
       return;
     }
-  //m_routingtable.DeleteAllRoutesFromInterface (m_ipv4->GetAddress (i, 0));
 
 }
 
@@ -838,7 +925,7 @@ RoutingProtocol::NotifyAddAddress (uint32_t i, Ipv4InterfaceAddress address)
           socket->BindToNetDevice (l3->GetNetDevice (i));
           socket->Bind (InetSocketAddress (iface.GetLocal (), SDSN_PORT));
           socket->SetAllowBroadcast (true);
-          m_socketAddresses.insert (std::make_pair (socket, iface));
+          AddSocket (socket, iface);
         }
     }
   else
@@ -856,7 +943,7 @@ RoutingProtocol::NotifyRemoveAddress (uint32_t i, Ipv4InterfaceAddress address)
     {
       //m_routingtable.DeleteAllRoutesFromInterface (address);
       socket->Close ();
-      m_socketAddresses.erase (socket);
+      RemoveSocket (socket);
 
       Ptr<Ipv4L3Protocol> l3 = m_ipv4->GetObject<Ipv4L3Protocol> ();
       if (l3->GetNAddresses (i))
@@ -872,7 +959,7 @@ RoutingProtocol::NotifyRemoveAddress (uint32_t i, Ipv4InterfaceAddress address)
           socket->Bind (InetSocketAddress (iface.GetLocal (), SDSN_PORT));
           socket->SetAllowBroadcast (false);
           socket->SetIpRecvTtl (true);
-          m_socketAddresses.insert (std::make_pair (socket, iface));
+          AddSocket (socket, iface);
         }
       if (m_socketAddresses.empty ())
         {
@@ -947,7 +1034,7 @@ NetView::SetControlDomain(Ptr<Node> con, NodeContainer swc)
 }
 
 void
-NetView::ControlPathRouting(Ptr<Node> swc, std::vector<std::pair<Ptr<Node>,NetViewEdge>> control_path)
+NetView::ControlPathRouting(Ptr<Node> swc, std::vector<std::pair<Ptr<Node>,NetViewEdge>> control_path, bool replace)
 {
   //m_ConIp
 
@@ -1005,6 +1092,7 @@ NetView::ControlPathRouting(Ptr<Node> swc, std::vector<std::pair<Ptr<Node>,NetVi
 
       ro_to_con.SetGateway(gate_way);
       ro_to_con.SetOutputDevice(it->second.GetDevice(2));
+      if(replace) path_rp->DeleteRoute(con_ip);
       path_rp->AddRoute(ro_to_con);
 
       //route to swc;
@@ -1012,73 +1100,150 @@ NetView::ControlPathRouting(Ptr<Node> swc, std::vector<std::pair<Ptr<Node>,NetVi
       cur_interface =  cur_ipv4->GetInterfaceForDevice(it->second.GetDevice(2));
       ro_to_swc.SetGateway(cur_ipv4->GetAddress(cur_interface, 0).GetLocal());
       ro_to_swc.SetOutputDevice(it->second.GetDevice(1));
+      if(replace) uphop_ipv4->GetObject<RoutingProtocol>()->DeleteRoute(src_ip);
       uphop_ipv4->GetObject<RoutingProtocol>()->AddRoute(ro_to_swc);
     }
 
+  //remember the devices of the path, a link going down finds its switches here
+  std::vector<Ptr<NetDevice>>& devs = m_controlDevices[swc];
+  for(auto it = devs.begin(); it != devs.end(); ++it)
+    {
+      m_deviceSwitches[*it].erase(swc);
+    }
+  devs.clear();
+  Time delay = Seconds(0);
+  for(auto it = control_path.begin(); it != control_path.end(); ++it)
+    {
+      delay += it->second.GetDelay();
+      devs.push_back(it->second.GetDevice(1));
+      devs.push_back(it->second.GetDevice(2));
+      m_deviceSwitches[it->second.GetDevice(1)].insert(swc);
+      m_deviceSwitches[it->second.GetDevice(2)].insert(swc);
+    }
+  m_controlDelay[swc] = delay;
+
   //Out Socket
   rp->SetOutSocket(src_ipv4->GetAddress(src_interface, 0));
 }
 
-void
-NetView::SetPair(Ptr<Node> con, Ptr<Node> swc)
+bool
+NetView::SetPair(Ptr<Node> con, Ptr<Node> swc, bool replace)
 {
   Ptr<RoutingProtocol> crp = con->GetObject<RoutingProtocol>();
   Ptr<RoutingProtocol> srp = swc->GetObject<RoutingProtocol>();
 
 
-  std::queue<std::pair<Ptr<Node>,NetViewEdge>> bfs;
-  std::map<Ptr<Node>,std::pair<Ptr<Node>,NetViewEdge>> Traversed; //Noted Node , Imported by
+  std::queue<Ptr<Node>> bfs;
+  std::map<Ptr<Node>,Ptr<Node>> Traversed; //Noted Node , Imported by
 
-  bfs.push(*(m_view.find(con)->second.begin()));
-  Traversed.insert(std::make_pair(con,*(m_view.find(con)->second.begin())));
+  bfs.push(con);
+  Traversed.insert(std::make_pair(con,con));
 
 
-  while (bfs.front().first != swc && !bfs.empty())
+  while (!bfs.empty() && bfs.front() != swc)
     {
-      for(auto it = ++m_view.find(bfs.front().first)->second.begin();it != m_view.find(bfs.front().first)->second.end(); it++)
+      std::pair<Slot*,Slot*> edges = GetEdges(bfs.front());
+      for(Slot* it = edges.first; it != edges.second; it++)
         {
-          if(Traversed.count(it->first)) continue;
-          bfs.push(*it);
-          Traversed.insert(std::make_pair(it->first, *(m_view.find(bfs.front().first)->second.begin())));
+          if(!it->second.IsUp() || Traversed.count(it->first)) continue;
+          bfs.push(it->first);
+          Traversed.insert(std::make_pair(it->first, bfs.front()));
         }
       bfs.pop();
     }
+  if(bfs.empty())
+    {
+      //the switch is cut off from its controller
+      return false;
+    }
+  m_controllerOf[swc] = con;
 
   std::vector<std::pair<Ptr<Node>,NetViewEdge>> control_path;
 
   Ptr<Node> temp = swc;
   while(temp != con)
     {
-      Ptr<Node> up_hop = Traversed.find(temp)->second.first;
-
-
-      for(auto it = m_view.find(up_hop)->second.begin();it != m_view.find(up_hop)->second.end(); it++)
-        {
-          if(it->first == temp)
-            {
-              control_path.push_back(*it);
-              temp = up_hop;
-              break;
-            }
-        }
-
-//      control_path.push_back(Traversed.find(temp)->second);
-//      temp = Traversed.find(temp)->second.first;
+      Ptr<Node> up_hop = Traversed.find(temp)->second;
+      control_path.push_back(*FindEdge(up_hop,temp));
+      temp = up_hop;
     }
 
-  ControlPathRouting(swc,control_path);
+  ControlPathRouting(swc,control_path,replace);
 
   crp->SetNodeType(CONTROLLER);
   crp->SetNodeState(CONNECTED);
   srp->SetNodeType(SWITCH);
   srp->SetNodeState(CONNECTED);
+  return true;
+}
 
+Time
+NetView::GetControlDelay(Ptr<Node> swc) const
+{
+  std::map<Ptr<Node>,Time>::const_iterator it = m_controlDelay.find(swc);
+  return it == m_controlDelay.end() ? Seconds(0) : it->second;
 }
 
 
 
 
 
+void
+NetView::LinkDown(Ptr<Node> node, Ptr<NetDevice> dev)
+{
+  Ptr<Channel> cha = dev->GetChannel();
+  if(!cha || cha->GetNDevices() != 2) return;
+  Ptr<NetDevice> odev = cha->GetDevice(0) == dev ? cha->GetDevice(1) : cha->GetDevice(0);
+
+  //mark the link down at both ends, a parallel link to the same node takes over the lookups
+  bool known = false;
+  Ptr<NetDevice> ends[2] = {dev, odev};
+  for(int e = 0; e < 2; ++e)
+    {
+      std::pair<Slot*,Slot*> edges = GetEdges(ends[e]->GetNode());
+      for(Slot* it = edges.first; it != edges.second; ++it)
+        {
+          if(it->second.GetDevice(1) != ends[e] || !it->second.IsUp()) continue;
+          it->second.SetDown();
+          known = true;
+          uint64_t key = (uint64_t)ends[e]->GetNode()->GetId() << 32 | it->first->GetId();
+          m_slotOf.erase(key);
+          for(Slot* other = edges.first; other != edges.second; ++other)
+            {
+              if(other->first == it->first && other->second.IsUp())
+                {
+                  m_slotOf[key] = other - m_edges.data();
+                  break;
+                }
+            }
+        }
+    }
+  if(!known) return;
+  ++m_linkFailures;
+  //the far end may not have noticed, its routes over the link go as well
+  Ptr<RoutingProtocol> orp = odev->GetNode()->GetObject<RoutingProtocol>();
+  if(orp) orp->DeleteRoutesThrough(odev);
+
+  //only the switches whose control path used the link are routed again
+  std::set<Ptr<Node>> affected;
+  for(int e = 0; e < 2; ++e)
+    {
+      std::map<Ptr<NetDevice>,std::set<Ptr<Node>>>::iterator it = m_deviceSwitches.find(ends[e]);
+      if(it != m_deviceSwitches.end()) affected.insert(it->second.begin(),it->second.end());
+    }
+  //the view changes at once; the time is what the failure report from
+  //'node' and the new routes down the longest new control path would take
+  Time done = Seconds(0);
+  for(std::set<Ptr<Node>>::iterator swc = affected.begin(); swc != affected.end(); ++swc)
+    {
+      std::map<Ptr<Node>,Ptr<Node>>::iterator con = m_controllerOf.find(*swc);
+      if(con == m_controllerOf.end() || !SetPair(con->second,*swc,true)) continue;
+      ++m_controlRepairs;
+      done = std::max(done,GetControlDelay(*swc));
+    }
+  m_reconvergence.push_back(GetControlDelay(node) + done);
+}
+
 void
 NetView::CalculateRouteFromSnap(Ipv4Address src, Ipv4Address dst)
 {
@@ -1122,16 +1287,14 @@ NetView::CalculateRouteFromSnap(Ipv4Address src, Ipv4Address dst)
 
       Ptr<Node> next = IndexToNode.find({oind.first,next_intra})->second;
 
-      for(auto it = m_view.find(ono)->second.begin(); it != m_view.find(ono)->second.end(); ++it)
+      Slot* it = FindEdge(ono,next);
+      if(it)
         {
-          if(it->first == next)
-            {
-              route.SetOutputDevice(it->second.GetDevice(1));
-              Ptr<Ipv4> ipv4 = next->GetObject<Ipv4>();
-              int interface = ipv4->GetInterfaceForDevice(it->second.GetDevice(2));
-              route.SetGateway(ipv4->GetAddress(interface, 0).GetLocal());
-              m_cal_route_cache[{src,dst}] = route;
-            }
+          route.SetOutputDevice(it->second.GetDevice(1));
+          Ptr<Ipv4> ipv4 = next->GetObject<Ipv4>();
+          int interface = ipv4->GetInterfaceForDevice(it->second.GetDevice(2));
+          route.SetGateway(ipv4->GetAddress(interface, 0).GetLocal());
+          m_cal_route_cache[{src,dst}] = route;
         }
     }
   else if(intra_plane_hop == 0)
@@ -1142,16 +1305,14 @@ NetView::CalculateRouteFromSnap(Ipv4Address src, Ipv4Address dst)
 
       Ptr<Node> next = IndexToNode.find({oind.first,next_inter})->second;
 
-      for(auto it = m_view.find(ono)->second.begin(); it != m_view.find(ono)->second.end(); ++it)
+      Slot* it = FindEdge(ono,next);
+      if(it)
         {
-          if(it->first == next)
-            {
-              route.SetOutputDevice(it->second.GetDevice(1));
-              Ptr<Ipv4> ipv4 = next->GetObject<Ipv4>();
-              int interface = ipv4->GetInterfaceForDevice(it->second.GetDevice(2));
-              route.SetGateway(ipv4->GetAddress(interface, 0).GetLocal());
-              m_cal_route_cache[{src,dst}] = route;
-            }
+          route.SetOutputDevice(it->second.GetDevice(1));
+          Ptr<Ipv4> ipv4 = next->GetObject<Ipv4>();
+          int interface = ipv4->GetInterfaceForDevice(it->second.GetDevice(2));
+          route.SetGateway(ipv4->GetAddress(interface, 0).GetLocal());
+          m_cal_route_cache[{src,dst}] = route;
         }
     }
   else
@@ -1175,17 +1336,15 @@ NetView::CalculateRouteFromSnap(Ipv4Address src, Ipv4Address dst)
       route2.SetDestination(dst);
       route2.SetSource(src);
 
-      for(auto it = m_view.find(ono)->second.begin(); it != m_view.find(ono)->second.end(); ++it)
+      Slot* edge1 = FindEdge(ono,next1);
+      if(edge1)
         {
-          if(it->first == next1)
-            {
-              load1 = it->second.GetLoad();
-              delay1 = it->second.GetDelay();
-              route1.SetOutputDevice(it->second.GetDevice(1));
-              ipv4_1 = next1->GetObject<Ipv4>();
-              int interface = ipv4_1->GetInterfaceForDevice(it->second.GetDevice(2));
-              route1.SetGateway(ipv4_1->GetAddress(interface, 0).GetLocal());
-            }
+          load1 = edge1->second.GetLoad();
+          delay1 = edge1->second.GetDelay();
+          route1.SetOutputDevice(edge1->second.GetDevice(1));
+          ipv4_1 = next1->GetObject<Ipv4>();
+          int interface = ipv4_1->GetInterfaceForDevice(edge1->second.GetDevice(2));
+          route1.SetGateway(ipv4_1->GetAddress(interface, 0).GetLocal());
         }
 
       int next_inter = oind.first;
@@ -1194,17 +1353,15 @@ NetView::CalculateRouteFromSnap(Ipv4Address src, Ipv4Address dst)
 
       Ptr<Node> next2 = IndexToNode.find({oind.first,next_inter})->second;
 
-      for(auto it = m_view.find(ono)->second.begin(); it != m_view.find(ono)->second.end(); ++it)
+      Slot* edge2 = FindEdge(ono,next2);
+      if(edge2)
         {
-          if(it->first == next2)
-            {
-              load2 = it->second.GetLoad();
-              delay2 = it->second.GetDelay();
-              route2.SetOutputDevice(it->second.GetDevice(1));
-              ipv4_2 = next2->GetObject<Ipv4>();
-              int interface = ipv4_2->GetInterfaceForDevice(it->second.GetDevice(2));
-              route2.SetGateway(ipv4_2->GetAddress(interface, 0).GetLocal());
-            }
+          load2 = edge2->second.GetLoad();
+          delay2 = edge2->second.GetDelay();
+          route2.SetOutputDevice(edge2->second.GetDevice(1));
+          ipv4_2 = next2->GetObject<Ipv4>();
+          int interface = ipv4_2->GetInterfaceForDevice(edge2->second.GetDevice(2));
+          route2.SetGateway(ipv4_2->GetAddress(interface, 0).GetLocal());
         }
 
       if(load1<load2)//a*delay+b*load+c*....
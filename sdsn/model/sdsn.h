@@ -8,7 +8,9 @@
 #include "ns3/point-to-point-module.h"
 #include <list>
 #include <vector>
+#include <unordered_map>
 #include <queue>
+#include <set>
 #include "ns3/random-variable-stream.h"
 
 namespace ns3 {
@@ -582,22 +584,29 @@ public:
     m_dev1=dev1;
     m_dev2=dev2;
     m_cha=cha;
+    // resolved once here, hellos read them for every edge
+    m_wcha=cha->GetObject<PointToPointWirelessChannel>();
+    Ptr<PointToPointWirelessNetDevice> wdev = dev1->GetObject<PointToPointWirelessNetDevice>();
+    if(wdev) m_queue=wdev->GetQueue();
+    m_up=true;
   }
 
   NetViewEdge()
-  : m_dev1(0),m_cha(0),m_dev2(0)
+  : m_dev1(0),m_cha(0),m_dev2(0),m_up(false)
   {
   }
 
+  bool IsUp() const {return m_up;}
+  void SetDown() {m_up=false;}
+
   Time GetDelay()
   {
-    return m_cha->GetObject<PointToPointWirelessChannel>()->GetDelay();
+    return m_wcha->GetDelay();
   }
 
   double GetLoad()
   {
-    Ptr<Queue<Packet>> que = m_dev1->GetObject<PointToPointWirelessNetDevice>()->GetQueue();
-    return (que->GetCurrentSize().GetValue())/(que->GetMaxSize().GetValue());
+    return (double)m_queue->GetCurrentSize().GetValue()/m_queue->GetMaxSize().GetValue();
   }
 
   Ptr<NetDevice> GetDevice(int dev){return dev == 1 ? m_dev1 : m_dev2;}
@@ -606,6 +615,9 @@ private:
   Ptr<NetDevice> m_dev1;
   Ptr<Channel> m_cha;
   Ptr<NetDevice> m_dev2;
+  Ptr<PointToPointWirelessChannel> m_wcha;
+  Ptr<Queue<Packet>> m_queue;
+  bool m_up;
 };
 
 class NodeInfo
@@ -615,14 +627,36 @@ public:
   void SetDelay(Time time){m_delay = time;}
   void SetLoad(double load){m_load = load;}
 
-  Time GetDelay(){return m_delay;}
-  uint32_t GetLoad(){return m_load;}
+  Time GetDelay() const {return m_delay;}
+  double GetLoad() const {return m_load;}
 
 private:
   Time m_delay;
   double m_load;
 };
 
+// Binary dump of NetView::m_snap, one fixed-size record per (master, slave)
+// pair following the header, so offline tools can mmap the file and index it.
+// Integers are in host byte order, times in nanoseconds.
+struct SnapHeader
+{
+  char magic[8];        // "SDSNSNAP"
+  uint32_t version;
+  uint32_t recordSize;
+  int64_t time;
+  uint64_t recordCount;
+  uint64_t recordOffset;
+};
+
+struct SnapRecord
+{
+  uint32_t master;      // Node::GetId ()
+  uint32_t slave;
+  int64_t timestamp;
+  int64_t delay;
+  double load;
+};
+
 class NetView
 {
 public:
@@ -641,18 +675,37 @@ public:
       {
         return *this;
       }
-    m_view = tmp.m_view;
+    m_nodes = tmp.m_nodes;
+    m_indexOfId = tmp.m_indexOfId;
+    m_offsets = tmp.m_offsets;
+    m_edges = tmp.m_edges;
+    m_slotOf = tmp.m_slotOf;
     return *this;
   }
 
   void InitSnap();
   void UpdateSnap(Ptr<Node> master, Ptr<Node> slave, Time time ,Time delay,double load);
+  bool WriteSnap(std::string filename) const;
+  // dump m_snap to 'filename' 'at' from now, as ControlCenter::ScheduleSnapshot
+  void ScheduleSnap(Time at, std::string filename);
 
 //  void SetUpdate(Callback<void,Time> func) {m_uddelay_func = func;}
 //  void SetUpdate(Callback<void,uint32_t> func) {m_udload_func = func;}
 
   void CalculateRouteFromSnap(Ipv4Address src, Ipv4Address dst);
 
+  // 'node' lost the link behind 'dev': the link is marked down in the view and the
+  // switches whose control path crossed it are paired again
+  void LinkDown(Ptr<Node> node, Ptr<NetDevice> dev);
+
+  // links of 'node' in device order, [first, second); down links stay in place
+  typedef std::pair<Ptr<Node>,NetViewEdge> Slot;
+  std::pair<Slot*,Slot*> GetEdges(Ptr<Node> node);
+  uint64_t GetLinkFailures() const {return m_linkFailures;}
+  uint64_t GetControlPathRepairs() const {return m_controlRepairs;}
+  // per link failure: report to the controller plus the longest new control path
+  const std::vector<Time>& GetReconvergence() const {return m_reconvergence;}
+
 
 
 public:
@@ -665,15 +718,32 @@ public:
 
 private:
 
-  typedef std::map<Ptr<Node>,std::list<std::pair<Ptr<Node>,NetViewEdge>>> Adjlist;
-  typedef std::list<std::pair<Ptr<Node>,NetViewEdge>> LList;
-  Adjlist m_view;
+  // edges in CSR form: the edges of the n-th node are m_edges[m_offsets[n]]
+  // up to m_offsets[n+1], each slot holds the neighbour and the link to it
+  std::vector<Ptr<Node>> m_nodes;
+  std::vector<int32_t> m_indexOfId;   // Node::GetId () -> n, -1 if not in the view
+  std::vector<uint32_t> m_offsets;
+  std::vector<Slot> m_edges;
+  std::unordered_map<uint64_t,uint32_t> m_slotOf;   // (id1 << 32 | id2) -> slot
+
+  int32_t IndexOf(Ptr<Node> node) const;
+  void WriteSnapEvent(std::string filename);
+  Slot* FindEdge(Ptr<Node> node1, Ptr<Node> node2);   // null if no live link
 
 //  std::map<Ptr<Node>,std::map<Ptr<Node>,std::pair<Time,NodeInfo>>> m_snap;
   std::map<std::pair<Ptr<Node>,Ptr<Node>>,std::pair<Time,NodeInfo>> m_snap;
 
   std::map<std::pair<Ipv4Address,Ipv4Address>,Ipv4Route> m_cal_route_cache;
 
+  // control path of every paired switch: its controller and the devices it uses
+  std::map<Ptr<Node>,Ptr<Node>> m_controllerOf;
+  std::map<Ptr<Node>,std::vector<Ptr<NetDevice>>> m_controlDevices;
+  std::map<Ptr<NetDevice>,std::set<Ptr<Node>>> m_deviceSwitches;
+  std::map<Ptr<Node>,Time> m_controlDelay;   // one-way delay of the control path
+  uint64_t m_linkFailures;
+  uint64_t m_controlRepairs;
+  std::vector<Time> m_reconvergence;
+
 
 
 
@@ -684,8 +754,9 @@ private:
 
 private:
 
-  void SetPair(Ptr<Node> con, Ptr<Node> swc);
-  void ControlPathRouting(Ptr<Node> swc, std::vector<std::pair<Ptr<Node>,NetViewEdge>> control_path);
+  bool SetPair(Ptr<Node> con, Ptr<Node> swc, bool replace = false);
+  Time GetControlDelay(Ptr<Node> swc) const;
+  void ControlPathRouting(Ptr<Node> swc, std::vector<std::pair<Ptr<Node>,NetViewEdge>> control_path, bool replace = false);
 
 };
 
@@ -698,18 +769,29 @@ public:
     if(!m_table.count(rte.GetDestination()))
       {
         m_table.insert(std::make_pair(rte.GetDestination(),rte));
+        m_deviceRoutes[rte.GetOutputDevice()].insert(rte.GetDestination());
       }
   }
   void Delete(Ipv4Address add)
   {
-    if(m_table.count(add))
+    std::map<Ipv4Address,Ipv4Route>::iterator it = m_table.find(add);
+    if(it != m_table.end())
       {
-        m_table.erase(add);
+        std::map<Ptr<NetDevice>,std::set<Ipv4Address>>::iterator dit = m_deviceRoutes.find(it->second.GetOutputDevice());
+        if(dit != m_deviceRoutes.end())
+          {
+            dit->second.erase(add);
+          }
+        m_table.erase(it);
       }
   }
   bool LookupRoute (Ipv4Address id, Ipv4Route & rt);
+  // removes the routes leaving through 'dev', returns their number
+  uint32_t DeleteRoutesThrough (Ptr<NetDevice> dev);
 private:
   std::map<Ipv4Address,Ipv4Route> m_table;
+  // output device -> destinations routed through it
+  std::map<Ptr<NetDevice>,std::set<Ipv4Address>> m_deviceRoutes;
 };
 
 class RoutingProtocol : public Ipv4RoutingProtocol
@@ -744,6 +826,11 @@ public:
     m_routingtable.Delete(add);
   }
 
+  uint32_t DeleteRoutesThrough(Ptr<NetDevice> dev)
+  {
+    return m_routingtable.DeleteRoutesThrough(dev);
+  }
+
   NodeType GetNodeType(){return m_type;}
   NodeState GetNodeState(){return m_state;}
 
@@ -787,6 +874,9 @@ private:
   void SendReply (RRHeader const & rreqHeader, Ipv4Route const & toOrigin);
 
   Ptr<Socket> FindSocketWithInterfaceAddress (Ipv4InterfaceAddress addr ) const;
+  void AddSocket (Ptr<Socket> socket, Ipv4InterfaceAddress iface);
+  void RemoveSocket (Ptr<Socket> socket);
+  void BuildLoopbackRoutes ();
 
   void RecvReply (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sender);
 
@@ -801,6 +891,12 @@ private:
   RoutingTable m_routingtable;
   Ptr<NetDevice> m_lo;
   std::map< Ptr<Socket>, Ipv4InterfaceAddress > m_socketAddresses;
+  // indices over m_socketAddresses, kept in step by AddSocket/RemoveSocket
+  std::unordered_map<Ipv4Address, Ptr<Socket>, Ipv4AddressHash> m_addressSockets;
+  std::vector<Ipv4Address> m_localAddresses;   // sorted
+  // source address of the loopback routes, one per output device
+  std::map<Ptr<NetDevice>, Ipv4Address> m_loopbackSources;
+  Ipv4Address m_defaultLoopbackSource;
   Ptr<Ipv4> m_ipv4;
   RequestQueue m_queue;
 
@@ -2,6 +2,11 @@
 
 // Include a header file from your module to test.
 #include "ns3/sdsn.h"
+#include "ns3/sdsn-helper.h"
+#include "ns3/point-to-point-wireless-helper.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/simulator.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -46,6 +51,152 @@ SdsnTestCase1::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
 }
 
+// Nodes 0-3 joined by 0-1 (1ms), 1-2 (1ms), 0-2 (5ms), 2-3 (1ms) and a
+// second 0-1 link (3ms), in that device order
+static NodeContainer
+BuildView (sdsn::NetView &view)
+{
+  NodeContainer c;
+  c.Create (4);
+  int ends[5][2] = {{0, 1}, {1, 2}, {0, 2}, {2, 3}, {0, 1}};
+  int delays[5] = {1, 1, 5, 1, 3};
+  NetDeviceContainer devices;
+  for (int i = 0; i < 5; ++i)
+    {
+      PointToPointWirelessHelper link;
+      link.SetChannelAttribute ("Delay", TimeValue (MilliSeconds (delays[i])));
+      devices.Add (link.Install (c.Get (ends[i][0]), c.Get (ends[i][1])));
+    }
+  SdsnHelper sdsnh;
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (sdsnh);
+  stack.Install (c);
+  Ipv4AddressHelper ip;
+  ip.SetBase ("10.1.1.0", "255.255.255.0");
+  ip.Assign (devices);
+  view.Install (c);
+  return c;
+}
+
+// Edges are found by their two ends, a missing one reads as unreachable
+class SdsnEdgeLookupTestCase : public TestCase
+{
+public:
+  SdsnEdgeLookupTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdsnEdgeLookupTestCase::SdsnEdgeLookupTestCase ()
+  : TestCase ("Sdsn net view edge lookup")
+{
+}
+
+void
+SdsnEdgeLookupTestCase::DoRun (void)
+{
+  sdsn::NetView view;
+  NodeContainer c = BuildView (view);
+  NS_TEST_ASSERT_MSG_EQ (view.GetDelay (c.Get (1), c.Get (2)).second, MilliSeconds (1), "a link in the middle of a row");
+  NS_TEST_ASSERT_MSG_EQ (view.GetDelay (c.Get (2), c.Get (0)).second, MilliSeconds (5), "looked up from either end");
+  NS_TEST_ASSERT_MSG_EQ (view.GetDelay (c.Get (0), c.Get (1)).second, MilliSeconds (1), "the first of parallel links");
+  NS_TEST_ASSERT_MSG_EQ (view.GetDelay (c.Get (0), c.Get (3)).second, Seconds (99999), "no link between 0 and 3");
+  NS_TEST_ASSERT_MSG_EQ (view.GetLoad (c.Get (2), c.Get (3)).second, 0, "an idle link");
+  NS_TEST_ASSERT_MSG_EQ (view.GetLoad (c.Get (3), c.Get (0)).second, 1, "a missing link reads as full");
+  Simulator::Destroy ();
+}
+
+// The links of a node come in device order, down ones keep their place
+class SdsnEdgeOrderTestCase : public TestCase
+{
+public:
+  SdsnEdgeOrderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdsnEdgeOrderTestCase::SdsnEdgeOrderTestCase ()
+  : TestCase ("Sdsn net view edges in device order")
+{
+}
+
+void
+SdsnEdgeOrderTestCase::DoRun (void)
+{
+  sdsn::NetView view;
+  NodeContainer c = BuildView (view);
+  std::pair<sdsn::NetView::Slot *, sdsn::NetView::Slot *> edges = view.GetEdges (c.Get (0));
+  NS_TEST_ASSERT_MSG_EQ (edges.second - edges.first, 3, "three links at node 0");
+  uint32_t neighbors[3] = {1, 2, 1};
+  for (int i = 0; i < 3; ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (edges.first[i].first, c.Get (neighbors[i]), "neighbour of link " << i);
+      NS_TEST_ASSERT_MSG_EQ (edges.first[i].second.GetDevice (1), c.Get (0)->GetDevice (i), "device of link " << i);
+    }
+  edges = view.GetEdges (c.Get (3));
+  NS_TEST_ASSERT_MSG_EQ (edges.second - edges.first, 1, "a single link at node 3");
+  NS_TEST_ASSERT_MSG_EQ (edges.first->first, c.Get (2), "towards 2");
+
+  view.LinkDown (c.Get (0), c.Get (0)->GetDevice (1));
+  edges = view.GetEdges (c.Get (0));
+  NS_TEST_ASSERT_MSG_EQ (edges.second - edges.first, 3, "the down link stays in the row");
+  NS_TEST_ASSERT_MSG_EQ (edges.first[1].second.IsUp (), false, "in its place");
+  NS_TEST_ASSERT_MSG_EQ (edges.first[2].second.IsUp (), true, "the others are up");
+  Simulator::Destroy ();
+}
+
+// A failed link moves the lookups to a parallel link and only the switches
+// whose control path crossed it are paired with the controller again
+class SdsnLinkDownTestCase : public TestCase
+{
+public:
+  SdsnLinkDownTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SdsnLinkDownTestCase::SdsnLinkDownTestCase ()
+  : TestCase ("Sdsn link down pairs the affected switches again")
+{
+}
+
+void
+SdsnLinkDownTestCase::DoRun (void)
+{
+  sdsn::NetView view;
+  NodeContainer c = BuildView (view);
+  // by hop count: 1 over the first 0-1 link, 2 over 0-2, 3 over 0-2-3
+  NodeContainer switches;
+  for (uint32_t i = 1; i < c.GetN (); ++i)
+    {
+      switches.Add (c.Get (i));
+    }
+  view.SetControlDomain (c.Get (0), switches);
+
+  // a link no control path uses
+  view.LinkDown (c.Get (1), c.Get (1)->GetDevice (1));
+  NS_TEST_ASSERT_MSG_EQ (view.GetLinkFailures (), 1, "the failure is counted");
+  NS_TEST_ASSERT_MSG_EQ (view.GetControlPathRepairs (), 0, "no control path crossed it");
+  NS_TEST_ASSERT_MSG_EQ (view.GetDelay (c.Get (2), c.Get (1)).second, Seconds (99999), "gone from both ends");
+
+  view.LinkDown (c.Get (0), c.Get (0)->GetDevice (0));
+  NS_TEST_ASSERT_MSG_EQ (view.GetDelay (c.Get (1), c.Get (0)).second, MilliSeconds (3), "the parallel link takes over");
+  NS_TEST_ASSERT_MSG_EQ (view.GetControlPathRepairs (), 1, "switch 1 is paired again");
+  NS_TEST_ASSERT_MSG_EQ (view.GetReconvergence ().back (), MilliSeconds (3), "over the parallel link");
+
+  view.LinkDown (c.Get (2), c.Get (2)->GetDevice (1));
+  NS_TEST_ASSERT_MSG_EQ (view.GetControlPathRepairs (), 1, "2 and 3 have no path left");
+  NS_TEST_ASSERT_MSG_EQ (view.GetLinkFailures (), 3, "every failure is counted");
+
+  // the same link twice is one failure
+  view.LinkDown (c.Get (2), c.Get (2)->GetDevice (1));
+  NS_TEST_ASSERT_MSG_EQ (view.GetLinkFailures (), 3, "a known failure is not counted again");
+  Simulator::Destroy ();
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -61,6 +212,9 @@ SdsnTestSuite::SdsnTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new SdsnTestCase1, TestCase::QUICK);
+  AddTestCase (new SdsnEdgeLookupTestCase, TestCase::QUICK);
+  AddTestCase (new SdsnEdgeOrderTestCase, TestCase::QUICK);
+  AddTestCase (new SdsnLinkDownTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite